@@ -0,0 +1,331 @@
+/*
+ * actuator.c
+ *
+ *  Solenoid pull-in and PWM hold, or servo moves, with timed relock.
+ */
+
+#include "actuator.h"
+#include <msp430.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+#include "led.h"
+#include "keypad.h"
+
+#if KEYPAD_DA_PIN & ACTUATOR_SERVO_PIN
+#error KEYPAD_DA_PIN and ACTUATOR_SERVO_PIN are the same Port 2 pin
+#endif
+
+#define ACTUATOR_US_TO_ACLK(us) ((((uint32_t)(us)) << 12) / 125000)    // us * 32768 / 1000000
+
+static actuator_config_t actuator_config;
+static actuator_stats_t actuator_stats;
+static volatile uint8_t actuator_state = ACTUATOR_LOCKED;
+static int8_t actuator_timer = TIMER_NONE;
+static volatile uint8_t actuator_relocked;              // dwell over, for actuator_takeRelock()
+static uint8_t actuator_inCycle;                        // phases belong to an unlock cycle
+static uint32_t actuator_phaseAclk;                     // start of the current phase
+static uint32_t actuator_fullAclk;                      // this cycle so far
+static uint32_t actuator_holdAclk;
+static uint64_t actuator_totalUj;
+
+static void actuator_step(void);
+
+// Hold duty in PWM levels, as programmed.
+static uint8_t actuator_holdLevel(void) {
+    return (uint16_t)actuator_config.holdPercent * LED_LEVEL_MAX / 100;
+} // end actuator_holdLevel
+
+/* ====================================================================
+ * Outputs
+ * ==================================================================== */
+// Level 0 to LED_LEVEL_MAX; off and full power on GPIO, the rest TA0.1 PWM.
+static void actuator_solenoid(uint8_t level) {
+    if ((level == 0) || (level >= LED_LEVEL_MAX)) {
+        P1SEL &= ~ACTUATOR_SOLENOID_PIN;
+        if (level) {
+            P1OUT |= ACTUATOR_SOLENOID_PIN;
+        } else {
+            P1OUT &= ~ACTUATOR_SOLENOID_PIN;
+        }
+    } else {
+        TA0CCR1 = LED_PWM_PERIOD - level;               // set at TA0CCR1, reset at TA0CCR0
+        P1SEL |= ACTUATOR_SOLENOID_PIN;
+    }
+    led_updateTimers();
+} // end actuator_solenoid
+
+// Pulse width in microseconds every 20ms on TA1.2, 0 stops the pulses.
+static void actuator_servo(uint16_t us) {
+    if (us) {
+        TA1CCR2 = (uint16_t)ACTUATOR_US_TO_ACLK(us) - 1;  // reset at TA1CCR2, set at TA1CCR0
+        P2SEL |= ACTUATOR_SERVO_PIN;
+    } else {
+        P2SEL &= ~ACTUATOR_SERVO_PIN;                   // GPIO, low
+    }
+    led_updateTimers();
+} // end actuator_servo
+
+static void actuator_setupPins(void) {
+    P1SEL &= ~ACTUATOR_SOLENOID_PIN;
+    P2SEL &= ~ACTUATOR_SERVO_PIN;
+    P1OUT &= ~ACTUATOR_SOLENOID_PIN;
+    P2OUT &= ~ACTUATOR_SERVO_PIN;
+    if (actuator_config.mode == ACTUATOR_MODE_SOLENOID) {
+        P1DIR |= ACTUATOR_SOLENOID_PIN;
+        TA0CCTL1 = OUTMOD_3;
+    } else if (actuator_config.mode == ACTUATOR_MODE_SERVO) {
+        P2DIR |= ACTUATOR_SERVO_PIN;
+        TA1CCTL2 = OUTMOD_7;
+    }
+    led_updateTimers();
+} // end actuator_setupPins
+
+/* ====================================================================
+ * Phases
+ * ==================================================================== */
+// (Re)start the phase timer, 0 = none. In actuator_step() the one-shot
+// has already freed its slot, so actuator_timer is cleared there first.
+static void actuator_schedule(uint32_t ms) {
+    timer_stop(actuator_timer);
+    actuator_timer = ms ? timer_start(ms, 0, actuator_step) : TIMER_NONE;
+} // end actuator_schedule
+
+static void actuator_setState(uint8_t state) {
+    uint32_t now = timer_getAclk();
+    uint32_t elapsed = now - actuator_phaseAclk;
+
+    if (actuator_state == ACTUATOR_HOLD) {
+        actuator_holdAclk += elapsed;
+    } else if ((actuator_state != ACTUATOR_LOCKED) && (actuator_state != ACTUATOR_OPEN)) {
+        actuator_fullAclk += elapsed;                   // pull-in, servo moving
+    }
+    actuator_phaseAclk = now;
+    actuator_state = state;
+} // end actuator_setState
+
+static void actuator_beginCycle(void) {
+    if (!actuator_inCycle) {
+        actuator_inCycle = 1;
+        actuator_fullAclk = 0;
+        actuator_holdAclk = 0;
+    }
+} // end actuator_beginCycle
+
+// Energy of the finished cycle, full power P = V^2 / R or V * I:
+// mV * mV / ohm and mV * mA are both microwatts.
+static void actuator_endCycle(void) {
+    uint32_t uw;
+    uint64_t full;
+    uint64_t hold;
+
+    if (!actuator_inCycle) {
+        return;                                         // the move to locked at boot
+    }
+    actuator_inCycle = 0;
+
+    if (actuator_config.mode == ACTUATOR_MODE_SOLENOID) {
+        uw = (uint32_t)actuator_config.supplyMv * actuator_config.supplyMv / actuator_config.coilOhm;
+    } else {
+        uw = (uint32_t)actuator_config.supplyMv * actuator_config.servoMa / 1000;
+    }
+    full = (uint64_t)uw * actuator_fullAclk;
+    hold = (uint64_t)uw * actuator_holdAclk;
+
+    actuator_stats.cycles++;
+    actuator_stats.lastFullMs = TIMER_ACLK_TO_US(actuator_fullAclk) / 1000;
+    actuator_stats.lastHoldMs = TIMER_ACLK_TO_US(actuator_holdAclk) / 1000;
+    actuator_stats.lastUj = (uint32_t)((full + hold * actuator_holdLevel() / LED_LEVEL_MAX) / TIMER_ACLK_HZ);
+    actuator_stats.lastFullPowerUj = (uint32_t)((full + hold) / TIMER_ACLK_HZ);
+    actuator_totalUj += actuator_stats.lastUj;
+    actuator_stats.totalMj = (uint32_t)(actuator_totalUj / 1000);
+} // end actuator_endCycle
+
+static void actuator_release(void) {
+    actuator_schedule(0);
+    actuator_setState(ACTUATOR_LOCKED);
+    actuator_solenoid(0);
+    actuator_endCycle();
+} // end actuator_release
+
+static void actuator_close(void) {
+    actuator_setState(ACTUATOR_CLOSING);
+    actuator_servo(actuator_config.servoLockedUs);
+    actuator_schedule(actuator_config.servoMoveMs);
+} // end actuator_close
+
+// Rest of the dwell once a phase of the given length is over, at least 1ms.
+static uint32_t actuator_dwellAfter(uint16_t ms) {
+    return (actuator_config.dwellMs > ms) ? (actuator_config.dwellMs - ms) : 1;
+} // end actuator_dwellAfter
+
+// Phase timer callback, interrupt context: register writes only.
+static void actuator_step(void) {
+    actuator_timer = TIMER_NONE;
+
+    switch (actuator_state) {
+    case ACTUATOR_PULL_IN:
+        if (actuator_holdLevel() == 0) {
+            actuator_release();                         // momentary strike
+            actuator_relocked = 1;
+            break;
+        }
+        actuator_setState(ACTUATOR_HOLD);
+        actuator_solenoid(actuator_holdLevel());
+        if (actuator_config.dwellMs) {
+            actuator_schedule(actuator_dwellAfter(actuator_config.pullInMs));
+        }
+        break;
+    case ACTUATOR_HOLD:
+        actuator_release();                             // dwell over
+        actuator_relocked = 1;
+        break;
+    case ACTUATOR_OPENING:
+        actuator_setState(ACTUATOR_OPEN);
+        actuator_servo(0);                              // stays put without pulses
+        if (actuator_config.dwellMs) {
+            actuator_schedule(actuator_dwellAfter(actuator_config.servoMoveMs));
+        }
+        break;
+    case ACTUATOR_OPEN:
+        actuator_close();                               // dwell over
+        actuator_relocked = 1;
+        break;
+    case ACTUATOR_CLOSING:
+        actuator_setState(ACTUATOR_LOCKED);
+        actuator_servo(0);
+        actuator_endCycle();
+        break;
+    default:
+        break;
+    }
+} // end actuator_step
+
+/* ====================================================================
+ * Interface
+ * ==================================================================== */
+void actuator_init(void) {
+    actuator_config.mode = ACTUATOR_MODE;
+    actuator_config.holdPercent = ACTUATOR_HOLD_PERCENT;
+    actuator_config.pullInMs = ACTUATOR_PULL_IN_MS;
+    actuator_config.dwellMs = ACTUATOR_DWELL_MS;
+    actuator_config.servoLockedUs = ACTUATOR_SERVO_LOCKED_US;
+    actuator_config.servoUnlockedUs = ACTUATOR_SERVO_UNLOCKED_US;
+    actuator_config.servoMoveMs = ACTUATOR_SERVO_MOVE_MS;
+    actuator_config.supplyMv = ACTUATOR_SUPPLY_MV;
+    actuator_config.coilOhm = ACTUATOR_COIL_OHM;
+    actuator_config.servoMa = ACTUATOR_SERVO_MA;
+    actuator_setupPins();
+
+    if (actuator_config.mode == ACTUATOR_MODE_SERVO) {
+        actuator_close();                               // position unknown after a reset
+    }
+} // end actuator_init
+
+void actuator_configure(const actuator_config_t *config) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    actuator_lock();
+    actuator_schedule(0);                               // a servo relock is cut short
+    actuator_setState(ACTUATOR_LOCKED);
+    actuator_inCycle = 0;
+
+    actuator_config = *config;
+    if (actuator_config.coilOhm == 0) {
+        actuator_config.coilOhm = 1;
+    }
+    if (actuator_config.holdPercent > 100) {
+        actuator_config.holdPercent = 100;
+    }
+    actuator_setupPins();
+
+    if (actuator_config.mode == ACTUATOR_MODE_SERVO) {
+        actuator_close();
+    }
+    __set_interrupt_state(state);
+} // end actuator_configure
+
+void actuator_getConfig(actuator_config_t *config) {
+    *config = actuator_config;
+} // end actuator_getConfig
+
+void actuator_unlock(void) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    actuator_relocked = 0;                              // a relock not yet taken is for the last unlock
+    if (actuator_config.mode == ACTUATOR_MODE_SOLENOID) {
+        if (actuator_state == ACTUATOR_LOCKED) {
+            actuator_beginCycle();
+            actuator_setState(ACTUATOR_PULL_IN);
+            actuator_solenoid(LED_LEVEL_MAX);
+            actuator_schedule(actuator_config.pullInMs);
+        } else if ((actuator_state == ACTUATOR_HOLD) && actuator_config.dwellMs) {
+            actuator_schedule(actuator_config.dwellMs); // restart the dwell
+        }
+    } else if (actuator_config.mode == ACTUATOR_MODE_SERVO) {
+        if ((actuator_state == ACTUATOR_LOCKED) || (actuator_state == ACTUATOR_CLOSING)) {
+            actuator_beginCycle();
+            actuator_setState(ACTUATOR_OPENING);
+            actuator_servo(actuator_config.servoUnlockedUs);
+            actuator_schedule(actuator_config.servoMoveMs);
+        } else if ((actuator_state == ACTUATOR_OPEN) && actuator_config.dwellMs) {
+            actuator_schedule(actuator_config.dwellMs);
+        }
+    }
+    __set_interrupt_state(state);
+} // end actuator_unlock
+
+void actuator_lock(void) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    if ((actuator_state == ACTUATOR_PULL_IN) || (actuator_state == ACTUATOR_HOLD)) {
+        actuator_release();
+    } else if ((actuator_state == ACTUATOR_OPENING) || (actuator_state == ACTUATOR_OPEN)) {
+        actuator_close();
+    }
+    __set_interrupt_state(state);
+} // end actuator_lock
+
+uint8_t actuator_takeRelock(void) {
+    uint16_t state = __get_interrupt_state();
+    uint8_t relocked;
+
+    __disable_interrupt();
+    relocked = actuator_relocked;
+    actuator_relocked = 0;
+    __set_interrupt_state(state);
+    return relocked;
+} // end actuator_takeRelock
+
+uint8_t actuator_getState(void) {
+    return actuator_state;
+} // end actuator_getState
+
+void actuator_getStats(actuator_stats_t *stats) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    *stats = actuator_stats;
+    __set_interrupt_state(state);
+} // end actuator_getStats
+
+void actuator_dump(actuator_sink_t sink) {
+    static const char * const modes[] = { "none", "solenoid", "servo" };
+    actuator_stats_t stats;
+    char line[32];
+
+    actuator_getStats(&stats);
+    snprintf(line, sizeof(line), "%-8s cycles%6u", modes[actuator_config.mode], stats.cycles);
+    sink(line);
+    snprintf(line, sizeof(line), "in%5lu hold%7lums", (unsigned long)stats.lastFullMs,
+             (unsigned long)stats.lastHoldMs);
+    sink(line);
+    snprintf(line, sizeof(line), "mJ%6lu full%7lu", (unsigned long)(stats.lastUj / 1000),
+             (unsigned long)(stats.lastFullPowerUj / 1000));
+    sink(line);
+    snprintf(line, sizeof(line), "total%10lumJ", (unsigned long)stats.totalMj);
+    sink(line);
+} // end actuator_dump
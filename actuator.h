@@ -0,0 +1,103 @@
+/*
+ * actuator.h
+ *
+ *  Door strike / solenoid or servo drive on the Timer_A PWM outputs.
+ *
+ *  Solenoid mode drives a low-side MOSFET (with a flyback diode across the
+ *  coil) from P1.2. An unlock pulls the plunger in at full power for
+ *  pullInMs, then holds it with holdPercent PWM on TA0.1, which shares the
+ *  status LEDs' 512Hz Timer_A0 period (led.h). A held plunger needs a
+ *  fraction of the pull-in current, and the hold is by far the longest
+ *  phase, so this is where the battery goes.
+ *
+ *  Servo mode sends 50Hz pulses on P2.1 (TA1.2, sharing the LED pattern
+ *  step timer's 20ms period) for servoMoveMs to swing between the locked
+ *  and unlocked positions, then stops them: the horn stays where it is
+ *  without holding torque.
+ *
+ *  Either way the actuator relocks by itself dwellMs after an unlock, from
+ *  timer callbacks, independent of the main loop, and says so through
+ *  actuator_takeRelock() so the lock state machine can follow it rather
+ *  than show "Unlocked" for a locked door. dwellMs = 0 holds it until
+ *  actuator_lock(), at a solenoid's hold power all the while.
+ *
+ *  Energy per unlock cycle is worked out from the measured phase times and
+ *  the supply and load figures in the configuration, see actuator_dump().
+ *  It is the energy drawn from the actuator supply, not the MCU's; the
+ *  hold figure assumes the coil current follows the PWM (an upper bound,
+ *  coil inductance smoothing the current only lowers it).
+ */
+
+#ifndef ACTUATOR_H_
+#define ACTUATOR_H_
+
+#include <stdint.h>
+
+#define ACTUATOR_SOLENOID_PIN   BIT2                    // P1.2, TA0.1
+#define ACTUATOR_SERVO_PIN      BIT1                    // P2.1, TA1.2
+
+#define ACTUATOR_MODE_OFF       0                       // nothing fitted
+#define ACTUATOR_MODE_SOLENOID  1
+#define ACTUATOR_MODE_SERVO     2
+
+#define ACTUATOR_LOCKED         0                       // released / at the locked position
+#define ACTUATOR_PULL_IN        1                       // solenoid, full power
+#define ACTUATOR_HOLD           2                       // solenoid, holdPercent PWM
+#define ACTUATOR_OPENING        3                       // servo moving to unlocked
+#define ACTUATOR_OPEN           4                       // servo at unlocked, no pulses
+#define ACTUATOR_CLOSING        5                       // servo moving to locked
+
+/* ====================================================================
+ * Defaults, override at build time
+ * ==================================================================== */
+#ifndef ACTUATOR_MODE
+#define ACTUATOR_MODE           ACTUATOR_MODE_SOLENOID
+#endif
+#define ACTUATOR_PULL_IN_MS     150
+#define ACTUATOR_HOLD_PERCENT   30
+#define ACTUATOR_DWELL_MS       5000UL                  // strike released after this
+#define ACTUATOR_SERVO_LOCKED_US    1000
+#define ACTUATOR_SERVO_UNLOCKED_US  2000
+#define ACTUATOR_SERVO_MOVE_MS  600
+#define ACTUATOR_SUPPLY_MV      12000
+#define ACTUATOR_COIL_OHM       24                      // 0.5A, 6W at full power
+#define ACTUATOR_SERVO_MA       300                     // average while moving
+
+typedef struct {
+    uint8_t mode;                                       // ACTUATOR_MODE_*
+    uint8_t holdPercent;                                // solenoid hold duty, 0 releases after pull-in
+    uint16_t pullInMs;
+    uint32_t dwellMs;                                   // unlock to relock, 0 = until actuator_lock()
+    uint16_t servoLockedUs;                             // pulse widths
+    uint16_t servoUnlockedUs;
+    uint16_t servoMoveMs;                               // pulses sent per move
+    uint16_t supplyMv;                                  // for the energy figures
+    uint16_t coilOhm;
+    uint16_t servoMa;
+} actuator_config_t;
+
+typedef struct {
+    uint16_t cycles;                                    // unlock cycles completed since reset
+    uint32_t lastFullMs;                                // last cycle: pull-in or servo moves
+    uint32_t lastHoldMs;                                // last cycle: solenoid hold
+    uint32_t lastUj;                                    // last cycle, microjoules
+    uint32_t lastFullPowerUj;                           // the same cycle held at full power
+    uint32_t totalMj;
+} actuator_stats_t;
+
+typedef void (*actuator_sink_t)(const char *);
+
+/* ====================================================================
+ * Actuator Prototype Definitions
+ * ==================================================================== */
+void actuator_init(void);                               // defaults, locked; requires led_init() and timer_init()
+void actuator_configure(const actuator_config_t *);     // while locked
+void actuator_getConfig(actuator_config_t *);
+void actuator_unlock(void);                             // again while unlocked restarts the dwell
+void actuator_lock(void);
+uint8_t actuator_takeRelock(void);                      // 1 once after each relock at the end of the dwell
+uint8_t actuator_getState(void);
+void actuator_getStats(actuator_stats_t *);
+void actuator_dump(actuator_sink_t);                    // a few lines, e.g. console_println
+
+#endif /* ACTUATOR_H_ */
@@ -0,0 +1,345 @@
+/*
+ * audit.c
+ *
+ *  Batched, CRC-checked audit log in a ring of flash segments.
+ */
+
+#include "audit.h"
+#include <msp430.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+#include "flash.h"
+
+#define AUDIT_MAGIC         0x4155                      // "AU"
+#define AUDIT_HEADER        6                           // magic, sequence low, sequence high
+#define AUDIT_BATCH_TAG     0xB000                      // batch header: tag | record count
+#define AUDIT_RECORD_SIZE   6
+#define AUDIT_DELTA_MAX     0xFFFFUL                    // from here on a delta takes an AUDIT_EV_GAP record
+#define AUDIT_DUMP_RECORDS  7                           // below the stats line on the console
+
+static uint16_t audit_buffer[AUDIT_BATCH][3];           // encoded records waiting for a commit
+static uint8_t audit_count;
+static uint32_t audit_lastS;                            // now_ms() / 1000 of the last record
+
+static uint8_t audit_segment;                           // being written
+static uint16_t audit_offset;                           // append point in it
+static uint16_t audit_segRecords;                       // records in it
+static uint32_t audit_seq;                              // its sequence number
+static uint8_t audit_aheadErased;                       // the segment after it is erased
+
+static volatile int8_t audit_timer = TIMER_NONE;
+static volatile uint8_t audit_flushDue;
+static audit_stats_t audit_stats;
+
+static uint32_t audit_gapS;                             // readout: AUDIT_EV_GAP seconds not yet folded in
+static audit_record_t audit_tail[AUDIT_DUMP_RECORDS];   // readout: newest records for audit_dump()
+static uint16_t audit_tailCount;
+
+static uint32_t audit_addr(uint8_t segment) {
+    return AUDIT_BASE + (uint32_t)segment * FLASH_SEGMENT;
+} // end audit_addr
+
+static uint8_t audit_isErased(uint8_t segment) {
+    uint32_t addr = audit_addr(segment);
+    uint16_t i;
+
+    for (i = 0; i < FLASH_SEGMENT; i += 2) {
+        if (FLASH_READ16(addr + i) != 0xFFFF) {
+            return 0;
+        }
+    }
+    return 1;
+} // end audit_isErased
+
+// CRC-CCITT on the CRC16 module over words as programmed, so a batch is
+// checked against what actually landed in flash. Never 0xFFFF, an
+// unwritten CRC word can not pass.
+static uint16_t audit_crc(uint32_t addr, uint8_t words) {
+    CRCINIRES = 0xFFFF;
+    for (; words > 0; words--, addr += 2) {
+        CRCDI = FLASH_READ16(addr);
+    }
+    return (CRCINIRES == 0xFFFF) ? 0xFFFE : CRCINIRES;
+} // end audit_crc
+
+/* ====================================================================
+ * Writing
+ * ==================================================================== */
+static void audit_eraseAhead(void) {
+    flash_eraseSegment(audit_addr((audit_segment + 1) % AUDIT_SEGMENTS));
+    audit_stats.erases++;
+    audit_aheadErased = 1;
+} // end audit_eraseAhead
+
+// Move on to the next, oldest, segment. Its header goes in magic last, so
+// a segment is only found by audit_init() once it is usable.
+static void audit_open(void) {
+    if (!audit_aheadErased) {
+        audit_eraseAhead();                             // audit_service() did not get to it
+        audit_stats.forcedErases++;
+    }
+    if (audit_segRecords) {
+        audit_stats.sealedSegments++;
+        audit_stats.sealedRecords += audit_segRecords;
+    }
+
+    audit_segment = (audit_segment + 1) % AUDIT_SEGMENTS;
+    audit_seq++;
+
+    uint32_t base = audit_addr(audit_segment);
+    flash_write16(base + 2, (uint16_t)audit_seq);
+    flash_write16(base + 4, (uint16_t)(audit_seq >> 16));
+    flash_write16(base, AUDIT_MAGIC);
+
+    audit_offset = AUDIT_HEADER;
+    audit_segRecords = 0;
+    audit_aheadErased = 0;
+} // end audit_open
+
+// Program the buffered records as one batch, split over two segments if
+// the current one is nearly full.
+static void audit_commit(void) {
+    uint32_t start = timer_getAclk();
+    uint8_t done = 0;
+
+    uint16_t state = __get_interrupt_state();
+    __disable_interrupt();                              // the tick can not fire between the read and the stop
+    timer_stop(audit_timer);                            // TIMER_NONE once it has fired
+    audit_timer = TIMER_NONE;
+    audit_flushDue = 0;
+    __set_interrupt_state(state);
+
+    while (done < audit_count) {
+        uint16_t free = FLASH_SEGMENT - audit_offset;
+        uint8_t room = (free >= 4 + AUDIT_RECORD_SIZE) ? (free - 4) / AUDIT_RECORD_SIZE : 0;
+        uint8_t n = audit_count - done;
+        uint8_t i;
+
+        if (!room) {
+            audit_open();
+            continue;
+        }
+        if (n > room) {
+            n = room;
+        }
+
+        uint32_t addr = audit_addr(audit_segment) + audit_offset;
+        flash_write16(addr, AUDIT_BATCH_TAG | n);
+        for (i = 0; i < n; i++) {
+            flash_write16(addr + 2 + i * AUDIT_RECORD_SIZE, audit_buffer[done + i][0]);
+            flash_write16(addr + 4 + i * AUDIT_RECORD_SIZE, audit_buffer[done + i][1]);
+            flash_write16(addr + 6 + i * AUDIT_RECORD_SIZE, audit_buffer[done + i][2]);
+        }
+        flash_write16(addr + 2 + n * AUDIT_RECORD_SIZE, audit_crc(addr, 1 + 3 * n));  // last: validates the batch
+
+        audit_offset += 4 + n * AUDIT_RECORD_SIZE;
+        audit_segRecords += n;
+        done += n;
+    }
+
+    audit_count = 0;
+    audit_stats.commits++;
+    audit_stats.lastCommitUs = TIMER_ACLK_TO_US(timer_getAclk() - start);
+    if (audit_stats.lastCommitUs > audit_stats.maxCommitUs) {
+        audit_stats.maxCommitUs = audit_stats.lastCommitUs;
+    }
+} // end audit_commit
+
+// One-shot: its slot is free again by now, forget the handle so
+// audit_commit() does not stop whoever gets the slot next.
+static void audit_flushTick(void) {
+    audit_timer = TIMER_NONE;
+    audit_flushDue = 1;                                 // timer callback, interrupt context
+} // end audit_flushTick
+
+static void audit_push(uint16_t w0, uint16_t w1, uint16_t w2) {
+    if (audit_count == AUDIT_BATCH) {
+        audit_commit();                                 // audit_service() did not get to it
+    }
+
+    audit_buffer[audit_count][0] = w0;
+    audit_buffer[audit_count][1] = w1;
+    audit_buffer[audit_count][2] = w2;
+    audit_count++;
+
+    if (audit_count == 1) {
+        audit_timer = timer_start(AUDIT_FLUSH_MS, 0, audit_flushTick);
+    } else if (audit_count == AUDIT_BATCH) {
+        audit_flushDue = 1;
+    }
+} // end audit_push
+
+/* ====================================================================
+ * Reading
+ * ==================================================================== */
+// Decode one record, folding AUDIT_EV_GAP into the next. 1 if visited.
+static uint8_t audit_emit(uint16_t w0, uint16_t w1, uint16_t w2, audit_visitor_t visit) {
+    audit_record_t rec;
+
+    if ((w0 >> 8) == AUDIT_EV_GAP) {
+        audit_gapS += w1 | ((uint32_t)w2 << 16);
+        return 0;
+    }
+
+    rec.type = w0 >> 8;
+    rec.arg = (uint8_t)w0;
+    rec.user = w1;
+    rec.deltaS = w2 + audit_gapS;
+    audit_gapS = 0;
+    visit(&rec);
+    return 1;
+} // end audit_emit
+
+// Walk the batches of a segment and return the append point. Batches
+// that fail their CRC are skipped. Without a visitor *records gets the
+// records stored, with one the records visited.
+static uint16_t audit_walk(uint8_t segment, audit_visitor_t visit, uint16_t *records) {
+    uint32_t base = audit_addr(segment);
+    uint16_t offset = AUDIT_HEADER;
+
+    *records = 0;
+    while (offset + 4 <= FLASH_SEGMENT) {
+        uint16_t header = FLASH_READ16(base + offset);
+        uint8_t n = header & 0xFF;
+        uint8_t i;
+
+        if (header == 0xFFFF) {
+            break;                                      // end of the log
+        }
+        if (((header & 0xFF00) != AUDIT_BATCH_TAG) || !n || (n > AUDIT_BATCH) ||
+            (offset + 4 + n * AUDIT_RECORD_SIZE > FLASH_SEGMENT)) {
+            offset = FLASH_SEGMENT;                     // garbled: append nothing more here
+            break;
+        }
+
+        uint32_t addr = base + offset;
+        if (FLASH_READ16(addr + 2 + n * AUDIT_RECORD_SIZE) == audit_crc(addr, 1 + 3 * n)) {
+            if (!visit) {
+                *records += n;
+            }
+            for (i = 0; visit && (i < n); i++, addr += AUDIT_RECORD_SIZE) {
+                *records += audit_emit(FLASH_READ16(addr + 2), FLASH_READ16(addr + 4), FLASH_READ16(addr + 6), visit);
+            }
+        }
+        offset += 4 + n * AUDIT_RECORD_SIZE;
+    }
+
+    return offset;
+} // end audit_walk
+
+static void audit_keep(const audit_record_t *rec) {
+    audit_tail[audit_tailCount % AUDIT_DUMP_RECORDS] = *rec;
+    audit_tailCount++;
+} // end audit_keep
+
+/* ====================================================================
+ * Audit Functions
+ * ==================================================================== */
+void audit_init(void) {
+    uint8_t found = 0;
+    uint8_t segment;
+
+    for (segment = 0; segment < AUDIT_SEGMENTS; segment++) {
+        uint32_t base = audit_addr(segment);
+        if (FLASH_READ16(base) == AUDIT_MAGIC) {
+            uint32_t seq = FLASH_READ16(base + 2) | ((uint32_t)FLASH_READ16(base + 4) << 16);
+            if (!found || ((int32_t)(seq - audit_seq) > 0)) {
+                audit_segment = segment;
+                audit_seq = seq;
+                found = 1;
+            }
+        }
+    }
+
+    if (found) {
+        audit_offset = audit_walk(audit_segment, 0, &audit_segRecords);
+    } else {
+        audit_segment = AUDIT_SEGMENTS - 1;             // blank region: the first commit opens segment 0
+        audit_seq = 0;
+        audit_offset = FLASH_SEGMENT;
+        audit_segRecords = 0;
+    }
+    audit_aheadErased = audit_isErased((audit_segment + 1) % AUDIT_SEGMENTS);
+
+    audit_log(AUDIT_EV_BOOT, (uint8_t)SYSRSTIV, 0);
+} // end audit_init
+
+void audit_log(uint8_t type, uint8_t arg, uint16_t user) {
+    uint32_t nowS = now_ms() / 1000;
+    uint32_t delta = nowS - audit_lastS;
+
+    audit_lastS = nowS;
+    if (delta >= AUDIT_DELTA_MAX) {
+        audit_push((uint16_t)AUDIT_EV_GAP << 8, (uint16_t)delta, (uint16_t)(delta >> 16));
+        delta = 0;
+    }
+    audit_push(((uint16_t)type << 8) | arg, user, (uint16_t)delta);
+    audit_stats.logged++;
+} // end audit_log
+
+void audit_flush(void) {
+    if (audit_count) {
+        audit_commit();
+    }
+} // end audit_flush
+
+void audit_service(void) {
+    if (audit_flushDue) {
+        audit_flush();
+    }
+    if (!audit_aheadErased) {
+        audit_eraseAhead();                             // ~25ms, so only while idle
+    }
+} // end audit_service
+
+uint16_t audit_read(audit_visitor_t visit) {
+    uint16_t count = 0;
+    uint16_t records;
+    uint8_t k;
+    uint8_t i;
+
+    audit_gapS = 0;
+    for (k = 1; k <= AUDIT_SEGMENTS; k++) {             // oldest segment first
+        uint8_t segment = (audit_segment + k) % AUDIT_SEGMENTS;
+        if (FLASH_READ16(audit_addr(segment)) == AUDIT_MAGIC) {
+            audit_walk(segment, visit, &records);
+            count += records;
+        }
+    }
+    for (i = 0; i < audit_count; i++) {                 // not committed yet
+        count += audit_emit(audit_buffer[i][0], audit_buffer[i][1], audit_buffer[i][2], visit);
+    }
+
+    return count;
+} // end audit_read
+
+void audit_getStats(audit_stats_t *stats) {
+    *stats = audit_stats;
+} // end audit_getStats
+
+// "r/er  72 cmt  4120us": records per filled segment, i.e. per erase, and
+// the longest commit; then the newest records as type, user or argument
+// and seconds since the record before.
+void audit_dump(audit_sink_t sink) {
+    static const char *const names[] = { "?   ", "BOOT", "UNLK", "LOCK", "BAD ", "LOUT", "ADD " };
+    char line[32];
+    uint16_t perErase = audit_stats.sealedSegments ?
+                        (uint16_t)(audit_stats.sealedRecords / audit_stats.sealedSegments) : 0;
+    uint16_t i;
+
+    snprintf(line, sizeof(line), "r/er%4u cmt%6luus", perErase, (unsigned long)audit_stats.maxCommitUs);
+    sink(line);
+
+    audit_tailCount = 0;
+    audit_read(audit_keep);
+    i = (audit_tailCount > AUDIT_DUMP_RECORDS) ? (audit_tailCount - AUDIT_DUMP_RECORDS) : 0;
+    for (; i < audit_tailCount; i++) {
+        const audit_record_t *rec = &audit_tail[i % AUDIT_DUMP_RECORDS];
+        uint16_t value = ((rec->type == AUDIT_EV_UNLOCK) || (rec->type == AUDIT_EV_PIN_ADDED)) ? rec->user : rec->arg;
+
+        snprintf(line, sizeof(line), "%s %5u %8lus", names[(rec->type <= AUDIT_EV_PIN_ADDED) ? rec->type : 0],
+                 value, (unsigned long)rec->deltaS);
+        sink(line);
+    }
+} // end audit_dump
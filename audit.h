@@ -0,0 +1,75 @@
+/*
+ * audit.h
+ *
+ *  Append-only audit log in flash above 64KB (AUDIT in the linker file).
+ *
+ *  A record is 6 bytes: event type, a small argument (failure count,
+ *  reset cause), the user id and the seconds since the previous record.
+ *  Gaps over 18 hours take an extra AUDIT_EV_GAP record. Time restarts at
+ *  every AUDIT_EV_BOOT, there is no real-time clock.
+ *
+ *  Records collect in RAM and are programmed AUDIT_BATCH at a time, or
+ *  AUDIT_FLUSH_MS after the first one, as one batch: a header with the
+ *  count, the records and a CRC. A batch cut short by a reset fails its
+ *  CRC and is skipped on readout. Up to AUDIT_BATCH - 1 records can be
+ *  lost to a reset before they are committed.
+ *
+ *  The region is a ring of 512-byte segments, each with a sequence number.
+ *  When one fills up the next, oldest, is reused. The segment after the
+ *  one being written is erased ahead of time from audit_service(), which
+ *  the main loop calls while no key is being handled.
+ */
+
+#ifndef AUDIT_H_
+#define AUDIT_H_
+
+#include <stdint.h>
+#include "flash.h"
+
+#define AUDIT_BASE          0x12400UL                   // must match AUDIT in lnk_msp430f5529.cmd
+#define AUDIT_SIZE          0x2000UL
+#define AUDIT_SEGMENTS      (AUDIT_SIZE / FLASH_SEGMENT)
+#define AUDIT_BATCH         8                           // records per commit
+#define AUDIT_FLUSH_MS      10000UL                     // longest a record waits in RAM
+
+#define AUDIT_EV_BOOT       1                           // arg = SYSRSTIV reset cause
+#define AUDIT_EV_UNLOCK     2                           // user
+#define AUDIT_EV_LOCK       3
+#define AUDIT_EV_WRONG_PIN  4                           // arg = wrong PINs in a row
+#define AUDIT_EV_LOCKOUT    5                           // arg = wrong PINs in a row
+#define AUDIT_EV_PIN_ADDED  6                           // user
+#define AUDIT_EV_GAP        7                           // long delta, readout folds it into the next record
+
+typedef struct {
+    uint8_t type;
+    uint8_t arg;
+    uint16_t user;
+    uint32_t deltaS;                                    // seconds since the previous record
+} audit_record_t;
+
+typedef struct {
+    uint16_t logged;                                    // since reset
+    uint16_t commits;
+    uint16_t erases;
+    uint16_t forcedErases;                              // next segment was not erased ahead
+    uint16_t sealedSegments;                            // segments filled since reset
+    uint32_t sealedRecords;                             // records they held
+    uint32_t lastCommitUs;                              // ACLK resolution, 30.5us
+    uint32_t maxCommitUs;
+} audit_stats_t;
+
+typedef void (*audit_visitor_t)(const audit_record_t *);
+typedef void (*audit_sink_t)(const char *);
+
+/* ====================================================================
+ * Audit Prototype Definitions
+ * ==================================================================== */
+void audit_init(void);                                  // requires timer_init(), logs AUDIT_EV_BOOT
+void audit_log(uint8_t, uint8_t, uint16_t);             // type, arg, user; RAM only
+void audit_flush(void);                                 // commit what is buffered now
+void audit_service(void);                               // main loop while idle: due commits, erase ahead
+uint16_t audit_read(audit_visitor_t);                   // every record, oldest first; returns the count
+void audit_getStats(audit_stats_t *);
+void audit_dump(audit_sink_t);                          // stats and the newest records, e.g. console_println
+
+#endif /* AUDIT_H_ */
@@ -6,40 +6,392 @@
  */
 
 #include <msp430.h>
+#include <stdio.h>
 #include "clock.h"
+#include "timer.h"
+#include "i2c.h"
+#include "power.h"
 
+static uint8_t clock_stage = CLOCK_RUNNING;
+static volatile uint8_t clock_settleDue;               // set by the settle timer
+static uint8_t clock_level = CLOCK_PERF_LOW;            // level currently applied
+static uint8_t clock_baseLevel = CLOCK_PERF_LOW;        // level when nobody requests burst
+static uint8_t clock_burstRequests;                     // nested clock_requestBurst() calls
+static uint8_t clock_vcore;                             // current PMMCOREV level
+
+static uint8_t clock_source = CLOCK_SRC_REFO;           // current FLL reference
+static uint8_t clock_xtPending;                         // crystals still starting up
+static uint8_t clock_xt1Aclk;                           // ACLK runs from XT1
+static int8_t clock_xtTimer = TIMER_NONE;
+static volatile uint8_t clock_xtDue;                    // set by the crystal poll timer
+static volatile uint8_t clock_measureDue;               // set once the FLL has re-locked
+static uint32_t clock_measuredHz;                       // DCOCLKDIV from the self-test, 0 = none yet
+static uint32_t clock_startAclk;                        // ACLK count at clock_init()
+static uint32_t clock_setupAclk[3];                     // ACLK cycles until each source was usable
+
+#define CLOCK_PENDING_XT1   0x01
+#define CLOCK_PENDING_XT2   0x02
+
+static void clock_settled(void) {
+  clock_settleDue = 1;                      // timer callback, interrupt context
+}
+
+static void clock_xtTick(void) {
+  clock_xtDue = 1;                          // timer callback, interrupt context
+}
+
+static void clock_measureTick(void) {
+  clock_measureDue = 1;                     // timer callback, interrupt context
+}
+
+// Staged bring-up: the FLL is retargeted to CLOCK_TARGET_HZ here, but MCLK and SMCLK
+// stay divided down to roughly the reset frequency while the DCO settles,
+// so GPIO, I2C and the display can be brought up right away instead of
+// after a ~31ms busy wait. clock_service() applies the requested
+// performance level once the DCO has settled. Requires timer_init().
 void clock_init(void) {
-  // Increase Vcore setting to level3 to support fsystem=25MHz
+  // Increase Vcore setting to the level the clock profile needs
   // NOTE: Change core voltage one level at a time..
-  SetVcoreUp (0x01);
-  SetVcoreUp (0x02);
-  SetVcoreUp (0x03);
+  clock_vcore = 0;
+  while (clock_vcore < CLOCK_VCORE) {
+    SetVcoreUp (++clock_vcore);
+  }
+
+  clock_startAclk = timer_getAclk();
 
   UCSCTL3 = SELREF_2;                       // Set DCO FLL reference = REFO
   UCSCTL4 |= SELA_2;                        // Set ACLK = REFO
+  UCSCTL5 = CLOCK_LOW_DIVBITS;              // MCLK = SMCLK = DCOCLKDIV/CLOCK_LOW_DIV while settling
 
   __bis_SR_register(SCG0);                  // Disable the FLL control loop
   UCSCTL0 = 0x0000;                         // Set lowest possible DCOx, MODx
-  UCSCTL1 = DCORSEL_7;                      // Select DCO range 50MHz operation
-  UCSCTL2 = FLLD_0 + 762;                   // Set DCO Multiplier for 25MHz
+  UCSCTL1 = CLOCK_DCORSEL;                  // Select DCO range for the profile
+  UCSCTL2 = FLLD_0 + CLOCK_FLL_N;           // Set DCO Multiplier for the profile
                                             // (N + 1) * FLLRef = Fdco
                                             // (762 + 1) * 32768 = 25MHz
-                                            // Set FLL Div = fDCOCLK/2
+                                            // Set FLL Div = fDCOCLK/1
   __bic_SR_register(SCG0);                  // Enable the FLL control loop
 
   // Worst-case settling time for the DCO when the DCO range bits have been
   // changed is n x 32 x 32 x f_MCLK / f_FLL_reference. See UCS chapter in 5xx
   // UG for optimization.
-  // 32 x 32 x 25 MHz / 32,768 Hz ~ 780k MCLK cycles for DCO to settle
-  __delay_cycles(782000);
+  // 32 x 32 / 32,768 Hz ~ 31ms = CLOCK_SETTLE_CYCLES; instead of waiting
+  // here, a one-shot timer tells clock_service() when to check the DCO
+  // fault flag.
+  clock_stage = CLOCK_SETTLING;
+  clock_level = CLOCK_PERF_LOW;
+  clock_settleDue = 0;
+  timer_start(CLOCK_SETTLE_MS, 0, clock_settled);
+
+  // Crystals start in parallel with the DCO and are switched in by
+  // clock_service() once they run fault-free. REFO is used until then.
+  clock_xtPending = 0;
+#if CLOCK_USE_XT1
+  P5SEL |= BIT4 + BIT5;                     // XIN, XOUT
+  UCSCTL6 &= ~XT1OFF;                       // XT1 on, full drive for start-up
+  UCSCTL6 |= XCAP_3;                        // Internal load cap
+  clock_xtPending |= CLOCK_PENDING_XT1;
+#endif
+#if CLOCK_USE_XT2
+  P5SEL |= BIT2 + BIT3;                     // XT2IN, XT2OUT
+  UCSCTL6 &= ~XT2OFF;                       // XT2 on
+  clock_xtPending |= CLOCK_PENDING_XT2;
+#endif
+  if (clock_xtPending) {
+    clock_xtTimer = timer_start(CLOCK_XT_POLL_MS, CLOCK_XT_POLL_MS, clock_xtTick);
+  }
+}
+
+// Switch the FLL reference. The DCO range is unchanged, so the FLL only has
+// to trim DCOx/MODx; the self-test runs once it has re-locked.
+static void clock_setReference(uint8_t source) {
+  __bis_SR_register(SCG0);                  // Disable the FLL control loop
+  if (source == CLOCK_SRC_XT2) {
+    UCSCTL3 = SELREF_5 + CLOCK_XT2_REFDIV;  // FLL reference = XT2/n = 1MHz
+    UCSCTL2 = FLLD_0 + CLOCK_FLL_N_XT2;
+  } else {
+    UCSCTL3 = (source == CLOCK_SRC_XT1) ? SELREF_0 : SELREF_2;
+    UCSCTL2 = FLLD_0 + CLOCK_FLL_N;         // both 32768Hz references
+  }
+  __bic_SR_register(SCG0);                  // Enable the FLL control loop
+
+  clock_source = source;
+  clock_measuredHz = 0;                     // nominal until measured again
+  clock_measureDue = 0;
+  timer_start(CLOCK_MEASURE_SETTLE_MS, 0, clock_measureTick);
+}
+
+static void clock_dropXt1(void) {
+  UCSCTL4 = (UCSCTL4 & ~SELA_7) | SELA_2;   // ACLK = REFO
+  UCSCTL6 |= XT1OFF;
+  P5SEL &= ~(BIT4 + BIT5);
+  clock_xt1Aclk = 0;
+  if (clock_source == CLOCK_SRC_XT1) {
+    clock_setReference(CLOCK_SRC_REFO);
+  }
+}
+
+static void clock_dropXt2(void) {
+  if (clock_source == CLOCK_SRC_XT2) {
+    clock_setReference(clock_xt1Aclk ? CLOCK_SRC_XT1 : CLOCK_SRC_REFO);
+  }
+  UCSCTL6 |= XT2OFF;
+  P5SEL &= ~(BIT2 + BIT3);
+}
+
+// Poll the crystals that are still starting: switch each in once its fault
+// flag stays clear, give up on it after CLOCK_XT_TIMEOUT_MS.
+static void clock_xtService(void) {
+  uint8_t expired = (timer_getAclk() - clock_startAclk) >= TIMER_MS_TO_ACLK(CLOCK_XT_TIMEOUT_MS);
 
-  // Loop until XT1,XT2 & DCO stabilizes - In this case only DCO has to stabilize
-  do
-  {
-    UCSCTL7 &= ~(XT2OFFG + XT1LFOFFG + DCOFFG);
+  if (clock_xtPending & CLOCK_PENDING_XT1) {
+    UCSCTL7 &= ~XT1LFOFFG;                  // Clear XT1 fault flag
+    if (!(UCSCTL7 & XT1LFOFFG)) {
+      clock_xtPending &= ~CLOCK_PENDING_XT1;
+      clock_setupAclk[CLOCK_SRC_XT1] = timer_getAclk() - clock_startAclk;
+      UCSCTL6 &= ~XT1DRIVE_3;               // lowest drive once oscillating
+      UCSCTL4 = (UCSCTL4 & ~SELA_7) | SELA_0;  // ACLK = XT1
+      clock_xt1Aclk = 1;
+      if (clock_source == CLOCK_SRC_REFO) {
+        clock_setReference(CLOCK_SRC_XT1);
+      }
+    } else if (expired) {
+      clock_xtPending &= ~CLOCK_PENDING_XT1;
+      clock_dropXt1();
+    }
+  }
+
+  if (clock_xtPending & CLOCK_PENDING_XT2) {
+    UCSCTL7 &= ~XT2OFFG;                    // Clear XT2 fault flag
+    if (!(UCSCTL7 & XT2OFFG)) {
+      clock_xtPending &= ~CLOCK_PENDING_XT2;
+      clock_setupAclk[CLOCK_SRC_XT2] = timer_getAclk() - clock_startAclk;
+      clock_setReference(CLOCK_SRC_XT2);    // preferred FLL reference
+    } else if (expired) {
+      clock_xtPending &= ~CLOCK_PENDING_XT2;
+      clock_dropXt2();
+    }
+  }
+
+  if (!clock_xtPending) {
+    timer_stop(clock_xtTimer);
+    clock_xtTimer = TIMER_NONE;
+  }
+}
+
+// A crystal in use has faulted: fall back to REFO (or XT1 for XT2).
+static void clock_checkFaults(void) {
+  UCSCTL7 &= ~(XT2OFFG + XT1LFOFFG + DCOFFG);
                                             // Clear XT2,XT1,DCO fault flags
-    SFRIFG1 &= ~OFIFG;                      // Clear fault flags
-  }while (SFRIFG1&OFIFG);                   // Test oscillator fault flag
+  SFRIFG1 &= ~OFIFG;                        // Clear fault flags
+
+  if ((clock_source == CLOCK_SRC_XT2) && (UCSCTL7 & XT2OFFG)) {
+    clock_dropXt2();
+  }
+  if (clock_xt1Aclk && (UCSCTL7 & XT1LFOFFG)) {
+    clock_dropXt1();
+  }
+}
+
+// Move MCLK/SMCLK and Vcore to a performance level. Frequency goes down
+// before Vcore, Vcore goes up before frequency. Must be called between I2C
+// transfers since the SCL divider is recomputed.
+static void clock_apply(uint8_t level) {
+  if (level == clock_level) {
+    return;
+  }
+
+  if (level == CLOCK_PERF_BURST) {
+    while (clock_vcore < CLOCK_VCORE) {
+      SetVcoreUp (++clock_vcore);           // one level at a time
+    }
+    UCSCTL5 = DIVM__1 + DIVS__1;            // MCLK = SMCLK = CLOCK_TARGET_HZ
+  } else {
+    UCSCTL5 = CLOCK_LOW_DIVBITS;            // MCLK = SMCLK = CLOCK_LOW_HZ
+    while (clock_vcore > 0) {
+      SetVcoreDown (--clock_vcore);         // one level at a time
+    }
+  }
+
+  clock_level = level;
+  power_mark();
+  i2c_updateClock();
+}
+
+static uint8_t clock_wantedLevel(void) {
+  return clock_burstRequests ? CLOCK_PERF_BURST : clock_baseLevel;
+}
+
+static void clock_serviceSettling(void) {
+  if (!clock_settleDue) {
+    return;                                 // DCO still settling
+  }
+  clock_settleDue = 0;
+
+  // Check if the DCO stabilized - crystals are checked separately
+  UCSCTL7 &= ~DCOFFG;                       // Clear DCO fault flag
+  if (UCSCTL7 & DCOFFG) {
+    timer_start(CLOCK_RECHECK_MS, 0, clock_settled);
+    return;                                 // Not locked yet, try again later
+  }
+
+  clock_setupAclk[CLOCK_SRC_REFO] = timer_getAclk() - clock_startAclk;
+  clock_stage = CLOCK_RUNNING;
+  clock_level = CLOCK_PERF_BURST;           // force clock_apply() to set the divider and Vcore
+  if (clock_wantedLevel() == CLOCK_PERF_BURST) {
+    UCSCTL5 = DIVM__1 + DIVS__1;            // Vcore is still at CLOCK_VCORE from clock_init()
+    power_mark();
+    i2c_updateClock();
+  } else {
+    clock_apply(CLOCK_PERF_LOW);
+  }
+  clock_measureMclk();
+}
+
+// Call from the main loop, between I2C transfers.
+void clock_service(void) {
+  if (clock_stage == CLOCK_SETTLING) {
+    clock_serviceSettling();
+    return;
+  }
+
+  if (clock_xtDue) {
+    clock_xtDue = 0;
+    clock_xtService();
+  }
+  if ((SFRIFG1 & OFIFG) && !clock_xtPending) {
+    clock_checkFaults();                    // starting crystals keep OFIFG set
+  }
+  if (clock_measureDue) {
+    clock_measureDue = 0;
+    clock_measureMclk();
+  }
+}
+
+uint8_t clock_getStage(void) {
+  return clock_stage;
+}
+
+// Set the level used while no burst is requested.
+void clock_setPerformance(uint8_t level) {
+  clock_baseLevel = level;
+  if (clock_stage == CLOCK_RUNNING) {
+    clock_apply(clock_wantedLevel());
+  }
+}
+
+uint8_t clock_getPerformance(void) {
+  return clock_level;
+}
+
+// Bracket CPU-heavy work (rendering, hashing, flash writes) with
+// clock_requestBurst() / clock_releaseBurst(). Calls may nest.
+void clock_requestBurst(void) {
+  clock_burstRequests++;
+  if (clock_stage == CLOCK_RUNNING) {
+    clock_apply(CLOCK_PERF_BURST);
+  }
+}
+
+void clock_releaseBurst(void) {
+  if (clock_burstRequests) {
+    clock_burstRequests--;
+  }
+  if (clock_stage == CLOCK_RUNNING) {
+    clock_apply(clock_wantedLevel());
+  }
+}
+
+// Nominal DCOCLKDIV for the current FLL reference, or the self-test result.
+static uint32_t clock_getDcoHz(void) {
+  if (clock_measuredHz) {
+    return clock_measuredHz;
+  }
+  if (clock_source == CLOCK_SRC_XT2) {
+    return (CLOCK_FLL_N_XT2 + 1) * CLOCK_XT2_REF_HZ;
+  }
+  return CLOCK_TARGET_HZ;
+}
+
+uint32_t clock_getMclk(void) {
+  uint32_t hz = clock_getDcoHz();
+  return (clock_level == CLOCK_PERF_BURST) ? hz : (hz / CLOCK_LOW_DIV);
+}
+
+uint32_t clock_getSmclk(void) {
+  return clock_getMclk();                   // SMCLK shares MCLK's source and divider
+}
+
+uint8_t clock_getSource(void) {
+  return clock_source;
+}
+
+// Self-test: count SMCLK cycles over CLOCK_MEASURE_PERIODS ACLK periods with
+// Timer_A2 capturing ACLK on CCI0B. The result is only as accurate as ACLK,
+// so it is meaningful with XT1, and against REFO it still catches a DCO
+// that did not lock. Blocks with interrupts off for ~2ms; Timer_A2 is
+// released afterwards. Returns and stores DCOCLKDIV in Hz.
+uint32_t clock_measureMclk(void) {
+  uint16_t first, last;
+  uint8_t n;
+  uint16_t gie = __get_SR_register() & GIE;
+
+  __disable_interrupt();
+  TA2CTL = TASSEL_2 + MC_2 + TACLR;         // SMCLK, continuous mode
+  TA2CCTL0 = CM_1 + CCIS_1 + SCS + CAP;     // capture rising ACLK edges, synchronous
+
+  while (!(TA2CCTL0 & CCIFG));
+  first = TA2CCR0;
+  TA2CCTL0 &= ~CCIFG;
+  for (n = CLOCK_MEASURE_PERIODS; n > 1; n--) {
+    while (!(TA2CCTL0 & CCIFG));
+    TA2CCTL0 &= ~CCIFG;
+  }
+  while (!(TA2CCTL0 & CCIFG));
+  last = TA2CCR0;
+
+  TA2CCTL0 = 0;
+  TA2CTL = 0;                               // stop Timer_A2
+  __bis_SR_register(gie);
+
+  // 16-bit difference: <= 48828 cycles at 25MHz over 64 periods
+  uint32_t hz = (uint32_t)(uint16_t)(last - first) * (TIMER_ACLK_HZ / CLOCK_MEASURE_PERIODS);
+  if (clock_level != CLOCK_PERF_BURST) {
+    hz *= CLOCK_LOW_DIV;
+  }
+  clock_measuredHz = hz;
+  return hz;
+}
+
+uint32_t clock_getMeasuredHz(void) {
+  return clock_measuredHz;
+}
+
+// Time from clock_init() until a source was usable: the DCO locked on REFO
+// for CLOCK_SRC_REFO, the crystal fault-free for XT1/XT2. 0 = not (yet).
+uint32_t clock_getSetupUs(uint8_t source) {
+  if (source > CLOCK_SRC_XT2) {
+    return 0;
+  }
+  return TIMER_ACLK_TO_US(clock_setupAclk[source]);
+}
+
+// Source and self-test result, then how long each source took to come
+// up; sources never started are left out. 0Hz = not measured yet.
+void clock_dump(clock_sink_t sink) {
+  static const char * const names[] = { "REFO", "XT1", "XT2" };
+  char line[24];
+  uint8_t i;
+
+  snprintf(line, sizeof(line), "clock %-4s%9luHz", names[clock_getSource()], (unsigned long)clock_getMeasuredHz());
+  sink(line);
+  for (i = CLOCK_SRC_REFO; i <= CLOCK_SRC_XT2; i++) {
+    uint32_t us = clock_getSetupUs(i);
+    if (us || (i == CLOCK_SRC_REFO)) {
+      snprintf(line, sizeof(line), "%-4s setup%8luus", names[i], (unsigned long)us);
+      sink(line);
+    }
+  }
 }
 
 void SetVcoreUp (unsigned int level)
@@ -64,3 +416,21 @@ void SetVcoreUp (unsigned int level)
   // Lock PMM registers for write access
   PMMCTL0_H = 0x00;
 }
+
+void SetVcoreDown (unsigned int level)
+{
+  // Open PMM registers for write
+  PMMCTL0_H = PMMPW_H;
+  // Set SVS/SVM low side to new level
+  SVSMLCTL = SVSLE + SVSLRVL0 * level + SVMLE + SVSMLRRL0 * level;
+  // Wait till SVM is settled
+  while ((PMMIFG & SVSMLDLYIFG) == 0);
+  // Clear already set flags
+  PMMIFG &= ~(SVMLVLRIFG + SVMLIFG);
+  // Set VCore to new level
+  PMMCTL0_L = PMMCOREV0 * level;
+  // Set SVS/SVM high side to new level
+  SVSMHCTL = SVSHE + SVSHRVL0 * level + SVMHE + SVSMHRRL0 * level;
+  // Lock PMM registers for write access
+  PMMCTL0_H = 0x00;
+}
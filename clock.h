@@ -6,11 +6,137 @@
  */
 
 #include <msp430.h>
+#include <stdint.h>
 
 #ifndef CLOCK_H_
 #define CLOCK_H_
 
+/* ====================================================================
+ * Clock Profile
+ *
+ * Select the full-speed MCLK/SMCLK at build time, e.g. -DCLOCK_PROFILE_MHZ=16.
+ * Every frequency dependent constant below is derived from it.
+ * ==================================================================== */
+#ifndef CLOCK_PROFILE_MHZ
+#define CLOCK_PROFILE_MHZ   25
+#endif
+
+#define CLOCK_FLL_REF_HZ    32768UL                     // REFO
+
+#if CLOCK_PROFILE_MHZ == 8
+#define CLOCK_DCORSEL       DCORSEL_5
+#define CLOCK_VCORE         0                           // PMMCOREV level for <= 8MHz
+#define CLOCK_LOW_DIV       4
+#define CLOCK_LOW_DIVBITS   (DIVM__4 + DIVS__4)
+#elif CLOCK_PROFILE_MHZ == 16
+#define CLOCK_DCORSEL       DCORSEL_5
+#define CLOCK_VCORE         2                           // PMMCOREV level for <= 20MHz
+#define CLOCK_LOW_DIV       8
+#define CLOCK_LOW_DIVBITS   (DIVM__8 + DIVS__8)
+#elif CLOCK_PROFILE_MHZ == 20
+#define CLOCK_DCORSEL       DCORSEL_6
+#define CLOCK_VCORE         2                           // PMMCOREV level for <= 20MHz
+#define CLOCK_LOW_DIV       16
+#define CLOCK_LOW_DIVBITS   (DIVM__16 + DIVS__16)
+#elif CLOCK_PROFILE_MHZ == 25
+#define CLOCK_DCORSEL       DCORSEL_7
+#define CLOCK_VCORE         3                           // PMMCOREV level for <= 25MHz
+#define CLOCK_LOW_DIV       16
+#define CLOCK_LOW_DIVBITS   (DIVM__16 + DIVS__16)
+#else
+#error CLOCK_PROFILE_MHZ must be 8, 16, 20 or 25
+#endif
+
+/* ====================================================================
+ * Crystal Options
+ *
+ * -DCLOCK_USE_XT1=1 runs ACLK (and the FLL reference) from the 32.768kHz
+ * crystal on P5.4/P5.5, -DCLOCK_USE_XT2=1 uses the crystal on P5.2/P5.3 as
+ * FLL reference. Both start in the background while the DCO locks on
+ * REFO; a crystal that does not start in CLOCK_XT_TIMEOUT_MS, or faults
+ * later, is turned off and REFO is used instead.
+ * ==================================================================== */
+#ifndef CLOCK_USE_XT1
+#define CLOCK_USE_XT1       0
+#endif
+#ifndef CLOCK_USE_XT2
+#define CLOCK_USE_XT2       0
+#endif
+#ifndef CLOCK_XT2_HZ
+#define CLOCK_XT2_HZ        4000000UL                   // LaunchPad XT2
+#endif
+
+#if CLOCK_XT2_HZ == 4000000UL
+#define CLOCK_XT2_REFDIV    FLLREFDIV_2                 // FLL reference = XT2/4 = 1MHz
+#define CLOCK_XT2_REF_HZ    (CLOCK_XT2_HZ / 4)
+#elif CLOCK_XT2_HZ == 8000000UL
+#define CLOCK_XT2_REFDIV    FLLREFDIV_3                 // FLL reference = XT2/8 = 1MHz
+#define CLOCK_XT2_REF_HZ    (CLOCK_XT2_HZ / 8)
+#else
+#error CLOCK_XT2_HZ must be 4MHz or 8MHz
+#endif
+
+#define CLOCK_XT_POLL_MS    10                          // crystal fault check interval while starting
+#define CLOCK_XT_TIMEOUT_MS 1000                        // give up on a crystal after this
+
+#define CLOCK_SRC_REFO      0
+#define CLOCK_SRC_XT1       1
+#define CLOCK_SRC_XT2       2
+
+// FLL multiplier with FLLD = 1: (N + 1) * 32768Hz, rounded to nearest
+#define CLOCK_FLL_N         ((CLOCK_PROFILE_MHZ * 1000000UL + CLOCK_FLL_REF_HZ / 2) / CLOCK_FLL_REF_HZ - 1)
+#define CLOCK_TARGET_HZ     ((CLOCK_FLL_N + 1) * CLOCK_FLL_REF_HZ)  // actual full-speed MCLK
+#define CLOCK_LOW_HZ        (CLOCK_TARGET_HZ / CLOCK_LOW_DIV)       // MCLK in CLOCK_PERF_LOW, ~1-2MHz
+
+#define CLOCK_FLL_N_XT2     ((CLOCK_PROFILE_MHZ * 1000000UL + CLOCK_XT2_REF_HZ / 2) / CLOCK_XT2_REF_HZ - 1)
+
+// MCLK self-test: SMCLK cycles are counted over this many ACLK periods
+// with a Timer_A2 capture of ACLK (CCI0B), ~2ms.
+#define CLOCK_MEASURE_PERIODS   64
+#define CLOCK_MEASURE_SETTLE_MS 4                       // FLL re-lock after a reference switch
+
+// DCO settling after a range change: 32 x 32 FLL reference cycles
+#define CLOCK_SETTLE_CYCLES (32UL * 32UL * (CLOCK_TARGET_HZ / CLOCK_FLL_REF_HZ))
+#define CLOCK_SETTLE_MS     ((32UL * 32UL * 1000UL + CLOCK_FLL_REF_HZ - 1) / CLOCK_FLL_REF_HZ + 1)
+#define CLOCK_RECHECK_MS    2                           // retry interval while the DCO is still faulted
+
+// I2C SCL dividers for 400kHz at either performance level
+#define CLOCK_I2C_SCL_HZ    400000UL
+#define CLOCK_I2C_DIV(hz)   ((((hz) + CLOCK_I2C_SCL_HZ - 1) / CLOCK_I2C_SCL_HZ) < 4 ? 4 : \
+                             (((hz) + CLOCK_I2C_SCL_HZ - 1) / CLOCK_I2C_SCL_HZ))
+#define CLOCK_I2C_DIV_BURST CLOCK_I2C_DIV(CLOCK_TARGET_HZ)
+#define CLOCK_I2C_DIV_LOW   CLOCK_I2C_DIV(CLOCK_LOW_HZ)
+
+// Cycle counts for the few short hardware waits that still use __delay_cycles
+#define CLOCK_US_TO_CYCLES_BURST(us)    ((uint32_t)(us) * (CLOCK_TARGET_HZ / 1000000UL))
+#define CLOCK_US_TO_CYCLES_LOW(us)      ((uint32_t)(us) * CLOCK_LOW_HZ / 1000000UL + 1)
+
+#define CLOCK_SETTLING      0
+#define CLOCK_RUNNING       1
+
+// Performance levels. The DCO stays locked at 25MHz in both, only the
+// MCLK/SMCLK divider and Vcore change, so a switch takes effect at once
+// instead of waiting for the FLL to settle again.
+#define CLOCK_PERF_LOW      0                           // CLOCK_LOW_HZ, Vcore level 0
+#define CLOCK_PERF_BURST    1                           // CLOCK_TARGET_HZ, Vcore CLOCK_VCORE
+
+typedef void (*clock_sink_t)(const char *);
+
 void clock_init(void);
+void clock_service(void);
+uint8_t clock_getStage(void);
+void clock_setPerformance(uint8_t);
+uint8_t clock_getPerformance(void);
+void clock_requestBurst(void);
+void clock_releaseBurst(void);
+uint32_t clock_getMclk(void);
+uint32_t clock_getSmclk(void);
+uint8_t clock_getSource(void);
+uint32_t clock_measureMclk(void);
+uint32_t clock_getMeasuredHz(void);
+uint32_t clock_getSetupUs(uint8_t);
+void clock_dump(clock_sink_t);                          // source, measured MCLK, setup times, e.g. console_println
 void SetVcoreUp (unsigned int level);
+void SetVcoreDown (unsigned int level);
 
 #endif /* CLOCK_H_ */
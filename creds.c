@@ -0,0 +1,408 @@
+/*
+ * creds.c
+ *
+ *  Flash hash table of salted PIN hashes with two-choice buckets.
+ */
+
+#include "creds.h"
+#include <msp430.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sha256.h"
+#include "clock.h"
+#include "timer.h"
+#include "flash.h"
+
+#define CREDS_MAGIC         0x4352                      // "CR"
+#define CREDS_VERSION       2                           // 1 stored the PIN itself
+
+// Header: magic, version, work factor, reserved, salt.
+#define CREDS_HDR_ROUNDS    4
+#define CREDS_HDR_SALT      8
+
+#define CREDS_DIE_RECORD    0x1A0A                      // TLV lot/wafer id and die position, 8 bytes
+
+// Key word: bits 0-29 PIN hash, 30 active, 31 clear when used.
+#define CREDS_KEY_MASK      0x3FFFFFFFUL
+#define CREDS_ACTIVE        0x40000000UL
+#define CREDS_FREE          0x80000000UL
+// Meta word: bits 0-13 user id, 14-15 role.
+#define CREDS_ROLE_SHIFT    14
+
+static uint16_t creds_active;
+static uint16_t creds_maxUser;
+static uint16_t creds_rounds;                           // work factor of this store
+static uint8_t creds_salt[CREDS_SALT_BYTES];
+
+static uint32_t creds_slotAddr(uint16_t slot) {
+    return CREDS_BASE + CREDS_HEADER + (uint32_t)slot * CREDS_SLOT_SIZE;
+} // end creds_slotAddr
+
+static uint32_t creds_readKey(uint32_t addr) {
+    return FLASH_READ16(addr) | ((uint32_t)FLASH_READ16(addr + 2) << 16);
+} // end creds_readKey
+
+// Key word for a PIN: h = SHA-256(salt, PIN padded to 8, length), then
+// rounds - 1 times h = SHA-256(h, salt), truncated to 30 bits. Every
+// PIN takes the same number of compressions, and the buffers holding the
+// PIN are wiped. 0 if the PIN is not 4-8 digits.
+static uint32_t creds_derive(const char *pin, uint16_t rounds) {
+    uint8_t msg[SHA256_BYTES + CREDS_SALT_BYTES];
+    uint32_t key;
+    uint8_t n = 0;
+    uint8_t i;
+
+    while (pin[n] != '\0') {
+        if ((pin[n] < '0') || (pin[n] > '9') || (n == CREDS_PIN_MAX)) {
+            return 0;
+        }
+        n++;
+    }
+    if (n < CREDS_PIN_MIN) {
+        return 0;
+    }
+
+    for (i = 0; i < CREDS_SALT_BYTES; i++) {
+        msg[i] = creds_salt[i];
+    }
+    for (i = 0; i < CREDS_PIN_MAX; i++) {
+        msg[CREDS_SALT_BYTES + i] = (i < n) ? pin[i] : 0;
+    }
+    msg[CREDS_SALT_BYTES + CREDS_PIN_MAX] = n;
+
+    clock_requestBurst();                               // the work factor is sized for full speed
+    sha256_short(msg, CREDS_SALT_BYTES + CREDS_PIN_MAX + 1, msg);
+    for (; rounds > 1; rounds--) {
+        for (i = 0; i < CREDS_SALT_BYTES; i++) {
+            msg[SHA256_BYTES + i] = creds_salt[i];
+        }
+        sha256_short(msg, sizeof(msg), msg);
+    }
+    clock_releaseBurst();
+
+    key = ((uint32_t)msg[0] << 24) | ((uint32_t)msg[1] << 16) | ((uint16_t)msg[2] << 8) | msg[3];
+    for (i = 0; i < sizeof(msg); i++) {
+        ((volatile uint8_t *)msg)[i] = 0;
+    }
+    return (key & CREDS_KEY_MASK) | CREDS_ACTIVE;
+} // end creds_derive
+
+// Device-unique die record plus the low bits of DCO cycles counted per
+// ACLK tick, which jitter with the FLL modulation, through SHA-256.
+static void creds_makeSalt(void) {
+    uint8_t msg[SHA256_BYTES + CREDS_SALT_BYTES];
+    uint8_t i;
+
+    for (i = 0; i < CREDS_SALT_BYTES; i += 2) {
+        uint16_t word = FLASH_READ16(CREDS_DIE_RECORD + i);
+        msg[i] = (uint8_t)word;
+        msg[i + 1] = (uint8_t)(word >> 8);
+    }
+    for (; i < sizeof(msg); i++) {
+        uint16_t tick = TB0R;
+        uint8_t count = 0;
+        while (TB0R == tick) {
+            count++;
+        }
+        msg[i] = count ^ (uint8_t)TB0R;
+    }
+
+    sha256_short(msg, sizeof(msg), msg);
+    for (i = 0; i < CREDS_SALT_BYTES; i++) {
+        creds_salt[i] = msg[i];
+    }
+} // end creds_makeSalt
+
+// Multiplicative hash, then a multiply instead of a modulo to pick the bucket.
+static uint16_t creds_bucket(uint32_t key, uint32_t multiplier) {
+    uint32_t h = key * multiplier;
+    return (uint16_t)(((h >> 16) * CREDS_BUCKETS) >> 16);
+} // end creds_bucket
+
+static uint8_t creds_isErased(uint32_t addr) {
+    return (creds_readKey(addr) == 0xFFFFFFFFUL) && (FLASH_READ16(addr + 4) == 0xFFFF);
+} // end creds_isErased
+
+// Scan one bucket up to its first erased slot. Returns the slot holding
+// the active key, or CREDS_SLOTS; *fill gets the number of slots in use.
+static uint16_t creds_scanBucket(uint16_t bucket, uint32_t key, uint8_t *fill) {
+    uint16_t slot = bucket * CREDS_BUCKET_SLOTS;
+    uint8_t i;
+
+    for (i = 0; i < CREDS_BUCKET_SLOTS; i++, slot++) {
+        uint32_t addr = creds_slotAddr(slot);
+        uint32_t word = creds_readKey(addr);
+
+        if (word == (key & ~CREDS_FREE)) {
+            *fill = i;
+            return slot;
+        }
+        if ((word == 0xFFFFFFFFUL) && creds_isErased(addr)) {
+            break;
+        }
+    }
+
+    *fill = i;
+    return CREDS_SLOTS;
+} // end creds_scanBucket
+
+// Slot holding the active key, or CREDS_SLOTS; at most CREDS_MAX_PROBE
+// comparisons. *b gets the bucket to add to, 0xFFFF if both are full.
+static uint16_t creds_find(uint32_t key, uint16_t *b) {
+    uint16_t b1 = creds_bucket(key, 2654435761UL);
+    uint16_t b2 = creds_bucket(key, 0x85EBCA6BUL);
+    uint8_t fill1, fill2 = CREDS_BUCKET_SLOTS;
+    uint16_t slot;
+
+    slot = creds_scanBucket(b1, key, &fill1);
+    if ((slot == CREDS_SLOTS) && (b2 != b1)) {
+        slot = creds_scanBucket(b2, key, &fill2);
+    }
+
+    if (b) {
+        if ((fill1 <= fill2) && (fill1 < CREDS_BUCKET_SLOTS)) {
+            *b = b1;
+        } else if (fill2 < CREDS_BUCKET_SLOTS) {
+            *b = b2;
+        } else {
+            *b = 0xFFFF;
+        }
+    }
+    return slot;
+} // end creds_find
+
+void creds_format(void) {
+    uint32_t addr;
+    uint8_t i;
+
+    for (addr = CREDS_BASE; addr < CREDS_BASE + CREDS_SIZE; addr += FLASH_SEGMENT) {
+        flash_eraseSegment(addr);
+    }
+
+    creds_makeSalt();
+    creds_rounds = CREDS_WORK_FACTOR;
+    for (i = 0; i < CREDS_SALT_BYTES; i += 2) {
+        flash_write16(CREDS_BASE + CREDS_HDR_SALT + i, creds_salt[i] | ((uint16_t)creds_salt[i + 1] << 8));
+    }
+    flash_write16(CREDS_BASE + CREDS_HDR_ROUNDS, creds_rounds);
+    flash_write16(CREDS_BASE + 2, CREDS_VERSION);
+    flash_write16(CREDS_BASE, CREDS_MAGIC);     // last: a cut-short format is redone
+    creds_active = 0;
+    creds_maxUser = 0;
+} // end creds_format
+
+// Requires nothing but flash; counts users once so creds_count() is free.
+void creds_init(void) {
+    uint16_t slot;
+    uint8_t i;
+
+    if ((FLASH_READ16(CREDS_BASE) != CREDS_MAGIC) || (FLASH_READ16(CREDS_BASE + 2) != CREDS_VERSION)) {
+        creds_format();                         // blank part, or code from an older layout
+    }
+
+    creds_rounds = FLASH_READ16(CREDS_BASE + CREDS_HDR_ROUNDS);   // kept from format, so stored hashes stay valid
+    for (i = 0; i < CREDS_SALT_BYTES; i += 2) {
+        uint16_t word = FLASH_READ16(CREDS_BASE + CREDS_HDR_SALT + i);
+        creds_salt[i] = (uint8_t)word;
+        creds_salt[i + 1] = (uint8_t)(word >> 8);
+    }
+
+    creds_active = 0;
+    creds_maxUser = 0;
+    for (slot = 0; slot < CREDS_SLOTS; slot++) {
+        uint32_t addr = creds_slotAddr(slot);
+        uint32_t word = creds_readKey(addr);
+        if (!(word & CREDS_FREE) && (word & CREDS_ACTIVE)) {
+            uint16_t user = FLASH_READ16(addr + 4) & CREDS_USER_MAX;
+            creds_active++;
+            if (user > creds_maxUser) {
+                creds_maxUser = user;
+            }
+        }
+    }
+
+    if (!creds_active) {
+        creds_add(CREDS_DEFAULT_PIN, CREDS_DEFAULT_USER, CREDS_ROLE_ADMIN); // until the first PIN is set
+    }
+} // end creds_init
+
+static uint8_t creds_addKey(uint32_t key, uint16_t userId, uint8_t role) {
+    uint16_t bucket;
+    uint8_t fill;
+
+    if (creds_find(key, &bucket) != CREDS_SLOTS) {
+        return CREDS_ERR_DUP;
+    }
+    if (bucket == 0xFFFF) {
+        return CREDS_ERR_FULL;
+    }
+
+    creds_scanBucket(bucket, key, &fill);               // first erased slot of the emptier bucket
+    uint32_t addr = creds_slotAddr(bucket * CREDS_BUCKET_SLOTS + fill);
+
+    // Meta first and the word with the used bit last: a slot cut short by
+    // a reset is skipped, never mistaken for a user.
+    flash_write16(addr + 4, userId | ((uint16_t)role << CREDS_ROLE_SHIFT));
+    flash_write16(addr, (uint16_t)key);
+    flash_write16(addr + 2, (uint16_t)(key >> 16));     // key has the used bit (31) clear
+    creds_active++;
+    if (userId > creds_maxUser) {
+        creds_maxUser = userId;
+    }
+    return CREDS_OK;
+} // end creds_addKey
+
+uint8_t creds_add(const char *pin, uint16_t userId, uint8_t role) {
+    uint32_t key = creds_derive(pin, creds_rounds);
+
+    if (!key || (userId > CREDS_USER_MAX)) {
+        return CREDS_ERR_PIN;
+    }
+    return creds_addKey(key, userId, role);
+} // end creds_add
+
+// Constant time for a given PIN length: the hash has a fixed cost and
+// all CREDS_MAX_PROBE slots of both buckets are compared without an
+// early exit or a data-dependent branch.
+uint8_t creds_lookup(const char *pin, creds_user_t *user) {
+    uint32_t key = creds_derive(pin, creds_rounds);
+    uint16_t bucket[2];
+    uint16_t found = 0;
+    uint16_t meta = 0;
+    uint8_t b, i;
+
+    if (!key) {
+        return CREDS_ERR_PIN;
+    }
+
+    bucket[0] = creds_bucket(key, 2654435761UL);
+    bucket[1] = creds_bucket(key, 0x85EBCA6BUL);
+    for (b = 0; b < 2; b++) {
+        uint32_t addr = creds_slotAddr(bucket[b] * CREDS_BUCKET_SLOTS);
+        for (i = 0; i < CREDS_BUCKET_SLOTS; i++, addr += CREDS_SLOT_SIZE) {
+            uint32_t diff = creds_readKey(addr) ^ key;
+            uint16_t match = (uint16_t)(((uint32_t)((uint16_t)diff | (uint16_t)(diff >> 16)) - 1) >> 16);  // 0xFFFF if equal
+            found |= match;
+            meta |= FLASH_READ16(addr + 4) & match;
+        }
+    }
+
+    if (!found) {
+        return CREDS_ERR_NOTFOUND;
+    }
+    if (user) {
+        user->userId = meta & CREDS_USER_MAX;
+        user->role = meta >> CREDS_ROLE_SHIFT;
+    }
+    return CREDS_OK;
+} // end creds_lookup
+
+uint8_t creds_revoke(const char *pin) {
+    uint32_t key = creds_derive(pin, creds_rounds);
+    uint16_t slot;
+
+    if (!key) {
+        return CREDS_ERR_PIN;
+    }
+    slot = creds_find(key, 0);
+    if (slot == CREDS_SLOTS) {
+        return CREDS_ERR_NOTFOUND;
+    }
+
+    uint32_t addr = creds_slotAddr(slot) + 2;
+    flash_write16(addr, FLASH_READ16(addr) & ~(uint16_t)(CREDS_ACTIVE >> 16));
+    creds_active--;
+    return CREDS_OK;
+} // end creds_revoke
+
+// Clears the active bit of every PIN of a user except the one with key
+// keep (0 keeps none, a derived key is never 0). Walks the whole table.
+static uint16_t creds_revokeOthers(uint16_t userId, uint32_t keep) {
+    uint16_t revoked = 0;
+    uint16_t slot;
+
+    for (slot = 0; slot < CREDS_SLOTS; slot++) {
+        uint32_t addr = creds_slotAddr(slot);
+        uint32_t word = creds_readKey(addr);
+        if (!(word & CREDS_FREE) && (word & CREDS_ACTIVE) && (word != keep) &&
+            ((FLASH_READ16(addr + 4) & CREDS_USER_MAX) == userId)) {
+            flash_write16(addr + 2, (uint16_t)(word >> 16) & ~(uint16_t)(CREDS_ACTIVE >> 16));
+            creds_active--;
+            revoked++;
+        }
+    }
+
+    return revoked;
+} // end creds_revokeOthers
+
+// Admin operation, walks the whole table.
+uint16_t creds_revokeUser(uint16_t userId) {
+    return creds_revokeOthers(userId, 0);
+} // end creds_revokeUser
+
+// The new PIN is added before the old ones are revoked, so a reset in
+// between leaves the user with both rather than with none. Setting the
+// PIN the user already has just revokes any others.
+uint8_t creds_replace(const char *pin, uint16_t userId, uint8_t role) {
+    uint32_t key = creds_derive(pin, creds_rounds);
+    uint16_t slot;
+
+    if (!key || (userId > CREDS_USER_MAX)) {
+        return CREDS_ERR_PIN;
+    }
+    slot = creds_find(key, 0);
+    if (slot != CREDS_SLOTS) {
+        if ((FLASH_READ16(creds_slotAddr(slot) + 4) & CREDS_USER_MAX) != userId) {
+            return CREDS_ERR_DUP;                       // another user's PIN
+        }
+    } else {
+        uint8_t result = creds_addKey(key, userId, role);
+        if (result != CREDS_OK) {
+            return result;
+        }
+    }
+
+    creds_revokeOthers(userId, key);
+    return CREDS_OK;
+} // end creds_replace
+
+uint16_t creds_count(void) {
+    return creds_active;
+} // end creds_count
+
+uint16_t creds_nextUserId(void) {
+    return (creds_maxUser < CREDS_USER_MAX) ? (creds_maxUser + 1) : CREDS_USER_MAX;
+} // end creds_nextUserId
+
+uint16_t creds_getWorkFactor(void) {
+    return creds_rounds;
+} // end creds_getWorkFactor
+
+// Time one PIN hash per work factor at full speed, in ms and thousands of
+// MCLK cycles. ACLK resolution, so small factors are rounded up to 30us.
+void creds_dumpHashCost(creds_sink_t sink) {
+    static const uint16_t factors[] = { 1, 8, 16, 32, 64 };
+    char line[32];
+    uint8_t i;
+
+    clock_requestBurst();
+    for (i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        uint32_t start = timer_getAclk();
+        creds_derive("0000", factors[i]);
+        uint32_t ticks = timer_getAclk() - start;
+        uint32_t kcycles = (uint32_t)(((uint64_t)ticks * clock_getMclk()) / TIMER_ACLK_HZ / 1000);
+
+        snprintf(line, sizeof(line), "wf%3u%c%5lums%6luk", factors[i], (factors[i] == creds_rounds) ? '*' : ' ',
+                 (unsigned long)TIMER_ACLK_TO_US(ticks) / 1000, (unsigned long)kcycles);
+        sink(line);
+    }
+
+    creds_user_t user;
+    uint32_t start = timer_getAclk();
+    creds_lookup("0000", &user);                        // hash at the store's factor, then both buckets
+    uint32_t ticks = timer_getAclk() - start;
+    snprintf(line, sizeof(line), "lookup%5lums of%4u", (unsigned long)TIMER_ACLK_TO_US(ticks) / 1000,
+             CREDS_BUDGET_MS);
+    sink(line);
+    clock_releaseBurst();
+} // end creds_dumpHashCost
@@ -0,0 +1,88 @@
+/*
+ * creds.h
+ *
+ *  Multi-user PIN store in flash, above 64KB (CREDS in the linker file).
+ *
+ *  PINs are never stored: a slot holds 30 bits of an iterated, salted
+ *  SHA-256 of the PIN. The salt is made per device when the store is
+ *  formatted, and the work factor (hash iterations) is fixed at format
+ *  time too, so changing CREDS_WORK_FACTOR takes a creds_format(). The
+ *  default is provisional: it assumes ~5ms per iteration at 25MHz, an
+ *  estimate that has not been measured on target. creds_dumpHashCost()
+ *  times each factor and a full lookup against CREDS_BUDGET_MS; set the
+ *  factor from those figures.
+ *
+ *  The 64KB region is a 16-byte header followed by a hash table of 682
+ *  buckets of 16 slots. A slot is 6 bytes: the packed PIN with a used and
+ *  an active bit, then the user id and role. Two hash functions give each
+ *  PIN two candidate buckets and it is stored in the emptier one, which
+ *  keeps buckets even enough for ~10,000 users. A lookup compares at most
+ *  CREDS_MAX_PROBE slots however many users there are. Slots fill each
+ *  bucket from the front and are only ever programmed from erased (1)
+ *  towards 0: adding writes an erased slot, revoking clears the active
+ *  bit in place. A revoked slot is reclaimed by creds_format() only.
+ *
+ *  PINs are 4 to 8 digits and unique, the PIN identifies the user. Two
+ *  PINs with the same 30-bit hash can not both be added (CREDS_ERR_DUP).
+ */
+
+#ifndef CREDS_H_
+#define CREDS_H_
+
+#include <stdint.h>
+
+#define CREDS_BASE          0x14400UL                   // must match CREDS in lnk_msp430f5529.cmd
+#define CREDS_SIZE          0x10000UL
+#define CREDS_HEADER        16
+#define CREDS_SLOT_SIZE     6
+#define CREDS_BUCKET_SLOTS  16
+#define CREDS_BUCKETS       682                         // (CREDS_SIZE - CREDS_HEADER) / 96
+#define CREDS_SLOTS         ((uint16_t)CREDS_BUCKETS * CREDS_BUCKET_SLOTS)
+#define CREDS_MAX_PROBE     (2 * CREDS_BUCKET_SLOTS)    // both candidate buckets
+
+#ifndef CREDS_WORK_FACTOR
+#define CREDS_WORK_FACTOR   16                          // SHA-256 compressions per PIN, provisional
+#endif
+#define CREDS_BUDGET_MS     150                         // verification latency target
+#define CREDS_SALT_BYTES    8
+
+#define CREDS_PIN_MIN       4
+#define CREDS_PIN_MAX       8
+#define CREDS_USER_MAX      0x3FFF                      // 14-bit user id
+
+#define CREDS_DEFAULT_PIN   "0000"                      // added to an empty store
+#define CREDS_DEFAULT_USER  0
+
+#define CREDS_ROLE_USER     0
+#define CREDS_ROLE_ADMIN    1
+#define CREDS_ROLE_SERVICE  2
+
+#define CREDS_OK            0
+#define CREDS_ERR_PIN       1                           // not 4-8 digits
+#define CREDS_ERR_DUP       2                           // PIN (hash) already active
+#define CREDS_ERR_FULL      3                           // both candidate buckets full
+#define CREDS_ERR_NOTFOUND  4
+
+typedef struct {
+    uint16_t userId;
+    uint8_t role;
+} creds_user_t;
+
+typedef void (*creds_sink_t)(const char *);
+
+/* ====================================================================
+ * Credential Prototype Definitions
+ * ==================================================================== */
+void creds_init(void);                                  // formats a blank or foreign region, adds the default PIN if empty
+void creds_format(void);                                // erase everything, ~3s
+uint8_t creds_add(const char *, uint16_t, uint8_t);     // PIN, user id, role
+uint8_t creds_lookup(const char *, creds_user_t *);     // active users only, user may be 0
+uint8_t creds_replace(const char *, uint16_t, uint8_t); // PIN, user id, role; the user's other PINs are revoked
+uint8_t creds_revoke(const char *);
+uint16_t creds_revokeUser(uint16_t);                    // all PINs of a user, returns how many
+uint16_t creds_count(void);                             // active credentials
+uint16_t creds_nextUserId(void);
+uint16_t creds_getWorkFactor(void);
+void creds_dumpHashCost(creds_sink_t);                  // hash time per work factor and a lookup, e.g. console_println
+
+#endif /* CREDS_H_ */
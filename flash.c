@@ -0,0 +1,34 @@
+/*
+ * flash.c
+ *
+ *  Flash controller access for the data regions above 64KB.
+ */
+
+#include "flash.h"
+#include <msp430.h>
+#include <stdint.h>
+
+void flash_write16(uint32_t addr, uint16_t value) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    FCTL3 = FWKEY;                              // Clear Lock bit
+    FCTL1 = FWKEY + WRT;                        // Enable word write
+    FLASH_WRITE16(addr, value);
+    while (FCTL3 & BUSY);
+    FCTL1 = FWKEY;                              // Clear WRT bit
+    FCTL3 = FWKEY + LOCK;                       // Set Lock bit
+    __set_interrupt_state(state);
+} // end flash_write16
+
+void flash_eraseSegment(uint32_t addr) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    FCTL3 = FWKEY;                              // Clear Lock bit
+    FCTL1 = FWKEY + ERASE;                      // Set Erase bit
+    FLASH_WRITE16(addr, 0);                     // Dummy write to erase Flash seg
+    while (FCTL3 & BUSY);
+    FCTL3 = FWKEY + LOCK;                       // Set Lock bit
+    __set_interrupt_state(state);
+} // end flash_eraseSegment
@@ -0,0 +1,37 @@
+/*
+ * flash.h
+ *
+ *  Word programming and segment erase of main flash at 20-bit addresses.
+ *
+ *  Data regions above 64KB (CREDS and AUDIT in the linker file) are read
+ *  with FLASH_READ16() and written with flash_write16(). Each call holds
+ *  interrupts off for one word (~85us) or one segment erase (~25ms).
+ */
+
+#ifndef FLASH_H_
+#define FLASH_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define FLASH_SEGMENT       512                         // main flash erase unit
+
+// Use the 20-bit data intrinsics, or plain pointers when the whole
+// program is built for the large data model.
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#define FLASH_READ16(addr)          __data20_read_short(addr)
+#define FLASH_WRITE16(addr, value)  __data20_write_short((addr), (value))
+#elif defined(__GNUC__)
+#define FLASH_READ16(addr)          (*(volatile uint16_t *)(uintptr_t)(addr))   // needs -mlarge
+#define FLASH_WRITE16(addr, value)  (*(volatile uint16_t *)(uintptr_t)(addr) = (value))
+#else
+#error Compiler not supported!
+#endif
+
+/* ====================================================================
+ * Flash Prototype Definitions
+ * ==================================================================== */
+void flash_write16(uint32_t, uint16_t);                 // address, value; the word must be erased
+void flash_eraseSegment(uint32_t);                      // any address in the segment
+
+#endif /* FLASH_H_ */
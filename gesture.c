@@ -0,0 +1,199 @@
+/*
+ * gesture.c
+ *
+ *  Tap, long-press, auto-repeat and chord recognition from keypad events.
+ */
+
+#include "gesture.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "keypad.h"
+#include "timer.h"
+
+#define GESTURE_F_LONG      0x01                        // long press reported
+#define GESTURE_F_CHORD     0x02                        // part of a chord
+#define GESTURE_F_REPEAT    0x04                        // at least one repeat reported
+
+typedef struct {
+    char key;                                           // 0 = slot free
+    uint8_t flags;
+    uint32_t downAclk;
+    uint32_t nextRepeat;                                // ACLK count of the next repeat
+} gesture_held_t;
+
+static const char gesture_keys[] = "123A456B789C*0#D";  // keypad order, bit n of gesture_repeatMask
+
+static gesture_held_t gesture_held[GESTURE_HELD];
+static uint8_t gesture_heldCount;
+static uint16_t gesture_repeatMask;
+
+static gesture_event_t gesture_queue[GESTURE_QUEUE_LEN];
+static uint8_t gesture_head;
+static uint8_t gesture_tail;
+
+static int8_t gesture_timer = TIMER_NONE;
+static volatile uint8_t gesture_tickDue;
+
+#if KEYPAD_HAS_RELEASE
+static void gesture_tick(void) {
+    gesture_tickDue = 1;                                // timer callback, interrupt context
+} // end gesture_tick
+#endif
+
+static uint16_t gesture_keyBit(char key) {
+    uint8_t i;
+    for (i = 0; i < 16; i++) {
+        if (gesture_keys[i] == key) {
+            return 1 << i;
+        }
+    }
+    return 0;
+} // end gesture_keyBit
+
+static uint8_t gesture_room(void) {
+    return GESTURE_QUEUE_LEN - (uint8_t)(gesture_head - gesture_tail);
+} // end gesture_room
+
+// Callers make room first, see gesture_service(): nothing is overwritten.
+static void gesture_emit(uint8_t type, char key, char key2, uint32_t aclk, uint32_t decodeAclk) {
+    gesture_event_t *g = &gesture_queue[gesture_head & (GESTURE_QUEUE_LEN - 1)];
+
+    g->key = key;
+    g->key2 = key2;
+    g->type = type;
+    g->aclk = aclk;
+    g->decodeAclk = decodeAclk;
+    gesture_head++;
+} // end gesture_emit
+
+static void gesture_press(const keypad_event_t *ev) {
+    gesture_held_t *slot = 0;
+    gesture_held_t *other = 0;
+    uint8_t i;
+
+    for (i = 0; i < GESTURE_HELD; i++) {
+        if (!gesture_held[i].key) {
+            if (!slot) {
+                slot = &gesture_held[i];
+            }
+        } else {
+            other = &gesture_held[i];
+        }
+    }
+
+    if (!slot) {
+        gesture_emit(GESTURE_DOWN, ev->key, 0, ev->aclk, ev->decodeAclk);  // beyond GESTURE_HELD keys: no gestures
+        return;
+    }
+
+    slot->key = ev->key;
+    slot->flags = 0;
+    slot->downAclk = ev->aclk;
+    slot->nextRepeat = ev->aclk + TIMER_MS_TO_ACLK(GESTURE_REPEAT_DELAY_MS);
+    gesture_heldCount++;
+
+    if (other && !(other->flags & GESTURE_F_CHORD) &&
+        ((uint32_t)(ev->aclk - other->downAclk) <= TIMER_MS_TO_ACLK(GESTURE_CHORD_MS))) {
+        other->flags |= GESTURE_F_CHORD;
+        slot->flags |= GESTURE_F_CHORD;
+        gesture_emit(GESTURE_CHORD, other->key, ev->key, ev->aclk, ev->decodeAclk);
+    } else {
+        gesture_emit(GESTURE_DOWN, ev->key, 0, ev->aclk, ev->decodeAclk);
+    }
+
+#if KEYPAD_HAS_RELEASE
+    if (gesture_timer == TIMER_NONE) {
+        gesture_timer = timer_start(GESTURE_TICK_MS, GESTURE_TICK_MS, gesture_tick);
+    }
+#endif
+} // end gesture_press
+
+static void gesture_release(const keypad_event_t *ev) {
+    uint8_t i;
+
+    for (i = 0; i < GESTURE_HELD; i++) {
+        gesture_held_t *h = &gesture_held[i];
+        if (h->key == ev->key) {
+#if KEYPAD_HAS_RELEASE
+            if (!h->flags) {
+                gesture_emit(GESTURE_TAP, h->key, 0, ev->aclk, ev->decodeAclk);
+            }
+#endif
+            h->key = 0;
+            gesture_heldCount--;
+            break;
+        }
+    }
+
+    if (!gesture_heldCount && (gesture_timer != TIMER_NONE)) {
+        timer_stop(gesture_timer);
+        gesture_timer = TIMER_NONE;
+    }
+} // end gesture_release
+
+static void gesture_checkHolds(void) {
+    uint32_t now = timer_getAclk();
+    uint8_t i;
+
+    for (i = 0; i < GESTURE_HELD; i++) {
+        gesture_held_t *h = &gesture_held[i];
+        if (!h->key || (h->flags & GESTURE_F_CHORD)) {
+            continue;
+        }
+
+        if (!(h->flags & GESTURE_F_LONG) &&
+            ((uint32_t)(now - h->downAclk) >= TIMER_MS_TO_ACLK(GESTURE_LONG_MS))) {
+            h->flags |= GESTURE_F_LONG;
+            gesture_emit(GESTURE_LONG, h->key, 0, now, now);
+        }
+
+        if ((gesture_repeatMask & gesture_keyBit(h->key)) && ((int32_t)(now - h->nextRepeat) >= 0)) {
+            h->flags |= GESTURE_F_REPEAT;
+            h->nextRepeat += TIMER_MS_TO_ACLK(GESTURE_REPEAT_MS);
+            gesture_emit(GESTURE_REPEAT, h->key, 0, now, now);
+        }
+    }
+} // end gesture_checkHolds
+
+// A keypad event makes at most one gesture and a tick at most two per
+// held key. While the gesture queue has no room for that, events stay in
+// the keypad queue and the tick stays due, so typed-ahead keys wait
+// instead of pushing out ones the main loop has not seen yet.
+void gesture_service(void) {
+    keypad_event_t ev;
+
+    while (gesture_room() && keypad_getEvent(&ev)) {
+        if (ev.type == KEYPAD_PRESS) {
+            gesture_press(&ev);
+        } else {
+            gesture_release(&ev);
+        }
+    }
+
+    if (gesture_tickDue && (gesture_room() >= 2 * GESTURE_HELD)) {
+        gesture_tickDue = 0;
+        gesture_checkHolds();
+    }
+} // end gesture_service
+
+uint8_t gesture_getEvent(gesture_event_t *g) {
+    if (gesture_tail == gesture_head) {
+        return 0;
+    }
+
+    *g = gesture_queue[gesture_tail & (GESTURE_QUEUE_LEN - 1)];
+    gesture_tail++;
+    return 1;
+} // end gesture_getEvent
+
+void gesture_setRepeat(char key, uint8_t enable) {
+    if (enable && KEYPAD_HAS_RELEASE) {
+        gesture_repeatMask |= gesture_keyBit(key);
+    } else {
+        gesture_repeatMask &= ~gesture_keyBit(key);
+    }
+} // end gesture_setRepeat
+
+uint8_t gesture_isIdle(void) {
+    return !gesture_heldCount && (gesture_head == gesture_tail);
+} // end gesture_isIdle
@@ -0,0 +1,65 @@
+/*
+ * gesture.h
+ *
+ *  Key gestures on top of the keypad event queue.
+ *
+ *  gesture_service() turns keypad press and release events into:
+ *    GESTURE_DOWN    on press, right away, so entry latency does not change
+ *    GESTURE_TAP     on release of a key that did nothing else
+ *    GESTURE_LONG    once, after a key has been held GESTURE_LONG_MS
+ *    GESTURE_REPEAT  every GESTURE_REPEAT_MS after GESTURE_REPEAT_DELAY_MS,
+ *                    for keys enabled with gesture_setRepeat()
+ *    GESTURE_CHORD   when a second key goes down within GESTURE_CHORD_MS
+ *                    of the first (key, key2); replaces the second DOWN
+ *
+ *  Each keypad event is handled in constant time. Hold times are checked
+ *  from a GESTURE_TICK_MS timer that only runs while a key is down.
+ *
+ *  Without real release events (BCD encoder without KEYPAD_DA_PIN, see
+ *  keypad.h) every press is a DOWN and nothing else: no TAP for the
+ *  release made up right after it, no LONG or REPEAT, no CHORD (the first
+ *  key is released before a second can go down). gesture_setRepeat() has
+ *  no effect there and the tick never runs. main.c therefore binds no
+ *  chords: a CHORD is taken as a DOWN of its second key.
+ *
+ *  Nothing is dropped here: when the main loop falls GESTURE_QUEUE_LEN
+ *  gestures behind, keypad events wait in the keypad queue instead, which
+ *  counts any it has to refuse (keypad_getDropped()).
+ */
+
+#ifndef GESTURE_H_
+#define GESTURE_H_
+
+#include <stdint.h>
+
+#define GESTURE_LONG_MS         3000
+#define GESTURE_REPEAT_DELAY_MS 500
+#define GESTURE_REPEAT_MS       150
+#define GESTURE_CHORD_MS        80
+#define GESTURE_TICK_MS         50                      // hold time resolution
+#define GESTURE_HELD            2                       // keys tracked at once, enough for a chord
+#define GESTURE_QUEUE_LEN       8                       // events, power of two
+
+#define GESTURE_DOWN            1
+#define GESTURE_TAP             2
+#define GESTURE_LONG            3
+#define GESTURE_REPEAT          4
+#define GESTURE_CHORD           5
+
+typedef struct {
+    char key;
+    char key2;                                          // second key of a chord, else 0
+    uint8_t type;
+    uint32_t aclk;                                      // first edge of the press, or the tick
+    uint32_t decodeAclk;                                // when the keypad queued the press, or the tick
+} gesture_event_t;
+
+/* ====================================================================
+ * Gesture Prototype Definitions
+ * ==================================================================== */
+void gesture_service(void);                             // main loop
+uint8_t gesture_getEvent(gesture_event_t *);            // 1 if an event was taken from the queue
+void gesture_setRepeat(char, uint8_t);                  // key, enable
+uint8_t gesture_isIdle(void);                           // no key held and no event waiting
+
+#endif /* GESTURE_H_ */
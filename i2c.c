@@ -9,22 +9,47 @@
 
 #include <msp430.h>
 #include <stdint.h>
+#include "clock.h"
+#include "power.h"
 
 #define SDA BIT1                                // i2c SDA pin on port 4
 #define SCL BIT2                                // i2c SCL pin on port 4
 
+unsigned char *PTxData;                         // Pointer to TX data
+volatile unsigned char TXByteCtr;               // i2c_write() sleeps until the ISR counts it down
+
+static void i2c_setDivider(void) {
+    uint16_t div;
+    if (clock_getPerformance() == CLOCK_PERF_BURST) {
+        div = CLOCK_I2C_DIV_BURST;              // derived from the clock profile at build time
+    } else {
+        div = CLOCK_I2C_DIV_LOW;
+    }
+    UCB1BR0 = div & 0xFF;                       // fSCL = SMCLK/div <= 400kHz (div = 63 at 25MHz)
+    UCB1BR1 = div >> 8;                         // UCBRx = (UCxxBR0 + UCxxBR1 * 256) -> fSCL = SMCLK/USBRx
+} // end i2c_setDivider
+
 void i2c_init(void) {
     P4SEL |= SDA | SCL;                         // Assign I2C pins to USCI_B1
     UCB1CTL1 |= UCSWRST;                        // Enable SW reset
     UCB1CTL0 = UCMST + UCMODE_3 + UCSYNC;       // I2C Master, synchronous mode
-    UCB1CTL1 = UCSSEL_2 + UCSWRST;              // Use SMCLK=24MHz, keep SW reset
-    UCB1BR0 = 64;                               // fSCL = SMCLK/64 = ~400kHz
-    UCB1BR1 = 0;                                // UCBRx = (UCxxBR0 + UCxxBR1 * 256) -> fSCL = SMCLK/USBRx
+    UCB1CTL1 = UCSSEL_2 + UCSWRST;              // Use SMCLK, keep SW reset
+    i2c_setDivider();
     UCB1I2CSA = 0x3C;                           // Slave Address is 0x3C
     UCB1CTL1 &= ~UCSWRST;                       // Clear SW reset, resume operation
     UCB1IE |= UCTXIE;                           // Enable TX interrupt
 } // end i2c_init
 
+void i2c_updateClock(void) {
+    if (!(UCB1CTL0 & UCMST)) {
+        return;                                 // i2c_init() not called yet
+    }
+    UCB1CTL1 |= UCSWRST;                        // Enable SW reset, bus must be idle
+    i2c_setDivider();
+    UCB1CTL1 &= ~UCSWRST;                       // Clear SW reset, resume operation
+    UCB1IE |= UCTXIE;                           // SW reset cleared the TX interrupt enable
+} // end i2c_updateClock
+
 void i2c_write(unsigned char *DataBuffer, unsigned char ByteCtr) {
     //__delay_cycles(10);                         // small wait
     PTxData = DataBuffer;                       // TX array start address
@@ -34,8 +59,16 @@ void i2c_write(unsigned char *DataBuffer, unsigned char ByteCtr) {
 
     UCB1CTL1 |= UCTR + UCTXSTT;                 // I2C TX, start condition
 
-    __bis_SR_register(LPM0_bits + GIE);         // Enter LPM0, enable interrupts
-    __no_operation();                           // Remain in LPM0 until all data
-                                                // is TX'd
+    __disable_interrupt();
+    while (TXByteCtr || (!(UCB1CTL1 & UCTXSTP) && (UCB1STAT & UCBBUSY))) {
+        power_sleepBegin(POWER_LPM0);
+        __bis_SR_register(LPM0_bits + GIE);     // Enter LPM0, enable interrupts
+        __no_operation();                       // Remain in LPM0 until all data
+                                                // is TX'd; other interrupts (timer
+                                                // ticks) may wake us early, so
+        __disable_interrupt();                  // re-check before sleeping again
+        power_sleepEnd();
+    }
+    __enable_interrupt();
     while (UCB1CTL1 & UCTXSTP);                 // Ensure stop condition got sent
 } // end i2c_write
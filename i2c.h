@@ -10,10 +10,11 @@
 
 #include <msp430.h>
 
-unsigned char *PTxData;                     // Pointer to TX data
-unsigned char TXByteCtr;
+extern unsigned char *PTxData;              // Pointer to TX data
+extern volatile unsigned char TXByteCtr;    // Bytes left, counted down by the USCI_B1 ISR
 
 void i2c_init(void); // Setup UCB1 for I2C
+void i2c_updateClock(void); // Recompute the SCL divider after an SMCLK change
 void i2c_write(unsigned char *, unsigned char); // write date to i2c bus
 
 #endif /* I2C_H_ */
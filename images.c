@@ -0,0 +1,72 @@
+/*
+ * images.c
+ *
+ *  Generated by tools/img_encode.py, do not edit.
+ *  Format described in tools/img_encode.py and ssd1306_image.h.
+ */
+
+#include "images.h"
+
+// 128x64, 1024 bytes raw
+const uint8_t img_splash[297] = {
+    0x80, 0x08, 0x02, 0xFF, 0x01, 0xFD, 0xBF, 0x05, 0xB7, 0x05, 0x05, 0xFD,
+    0x01, 0xFF, 0xFF, 0x00, 0xFF, 0xA4, 0x00, 0x84, 0xC0, 0xD1, 0x0D, 0xD3,
+    0x0B, 0x88, 0xC0, 0xCD, 0x17, 0x88, 0x00, 0xC0, 0x7C, 0xC9, 0x7F, 0x80,
+    0xC0, 0x80, 0xF0, 0x80, 0x3C, 0x86, 0x0F, 0x80, 0x3C, 0x80, 0xF0, 0xC8,
+    0x2C, 0xC0, 0x29, 0x81, 0x00, 0x80, 0x03, 0x80, 0xFC, 0xC9, 0x0F, 0xC3,
+    0x07, 0x82, 0x30, 0x80, 0xF3, 0xCB, 0x17, 0xCB, 0x23, 0x84, 0xC0, 0xC1,
+    0x0F, 0xCA, 0x1F, 0xC7, 0x7F, 0xC3, 0x1E, 0xC5, 0x28, 0xC5, 0x2E, 0xC3,
+    0x0F, 0x83, 0x00, 0x80, 0x0F, 0x82, 0x0C, 0x80, 0x03, 0x84, 0x00, 0x80,
+    0x0C, 0xC1, 0x0F, 0x82, 0x00, 0x80, 0x03, 0x84, 0x0C, 0x80, 0x0F, 0xCB,
+    0x17, 0xC3, 0x33, 0xCF, 0x07, 0xC3, 0x47, 0x82, 0x0C, 0xCA, 0x7F, 0x88,
+    0xFF, 0x80, 0x0F, 0x82, 0x03, 0x80, 0x0F, 0x88, 0xFF, 0x8F, 0x00, 0xC9,
+    0x12, 0x80, 0xFC, 0x84, 0x03, 0x80, 0xFC, 0xC7, 0x0B, 0xC2, 0x5B, 0x08,
+    0xFF, 0xC0, 0xC0, 0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03, 0x98, 0x00, 0xD2,
+    0x7F, 0x80, 0xFF, 0x80, 0xFC, 0x80, 0xF0, 0x8A, 0xFF, 0x8F, 0x00, 0x80,
+    0x3F, 0x86, 0x30, 0x80, 0x00, 0x80, 0x0F, 0x84, 0x30, 0x80, 0x0F, 0xC7,
+    0x0B, 0xC1, 0x7F, 0x80, 0x3F, 0x80, 0x00, 0x80, 0x03, 0x80, 0x0C, 0xC1,
+    0x23, 0xE0, 0x7F, 0xA8, 0x00, 0x06, 0xF8, 0x10, 0x60, 0x10, 0xF8, 0x00,
+    0x30, 0x81, 0x48, 0x02, 0x88, 0x00, 0xF8, 0x81, 0x48, 0x12, 0x30, 0x00,
+    0xC0, 0xA0, 0x90, 0xF8, 0x80, 0x00, 0x08, 0x08, 0x28, 0x58, 0x88, 0x00,
+    0xF0, 0x88, 0x48, 0x28, 0xF0, 0xC2, 0x17, 0x02, 0x08, 0x00, 0x38, 0xC2,
+    0x23, 0xC3, 0x05, 0x02, 0x10, 0x08, 0x88, 0xC0, 0x29, 0xC1, 0x35, 0x00,
+    0xF0, 0xCB, 0x7F, 0x01, 0x80, 0xBF, 0xAD, 0xA0, 0x00, 0xA3, 0xC2, 0x03,
+    0x82, 0xA2, 0x00, 0xA1, 0xC2, 0x0B, 0xC5, 0x14, 0x00, 0xA1, 0xC2, 0x11,
+    0xC3, 0x05, 0xC3, 0x17, 0xC9, 0x11, 0x01, 0xA2, 0xA3, 0x81, 0xA2, 0x80,
+    0xA0, 0xC1, 0x0A, 0x88, 0xA0, 0x02, 0xBF, 0x80, 0xFF,
+};
+
+// 16x16, 32 bytes raw
+const uint8_t img_lock_closed[30] = {
+    0x10, 0x02, 0x05, 0x00, 0x80, 0x80, 0xF8, 0xFC, 0x86, 0x82, 0x83, 0x06,
+    0x86, 0xFC, 0xF8, 0x80, 0x80, 0x00, 0x00, 0x83, 0xFF, 0x03, 0xF3, 0xE1,
+    0xC1, 0xF3, 0x83, 0xFF, 0x00, 0x00,
+};
+
+// 16x16, 32 bytes raw
+const uint8_t img_lock_open[30] = {
+    0x10, 0x02, 0x05, 0x00, 0x80, 0x80, 0xF8, 0xFC, 0x86, 0x82, 0x83, 0x06,
+    0x86, 0x9C, 0x98, 0x80, 0x80, 0x00, 0x00, 0x83, 0xFF, 0x03, 0xF3, 0xE1,
+    0xC1, 0xF3, 0x83, 0xFF, 0x00, 0x00,
+};
+
+// 16x16, 32 bytes raw
+const uint8_t img_check[27] = {
+    0x10, 0x02, 0x80, 0x80, 0x84, 0x00, 0x11, 0x80, 0xC0, 0xE0, 0x70, 0x38,
+    0x1C, 0x0E, 0x06, 0x01, 0x03, 0x07, 0x0E, 0x1C, 0x1C, 0x0E, 0x07, 0x03,
+    0x01, 0x84, 0x00,
+};
+
+// 16x16, 32 bytes raw
+const uint8_t img_cross[33] = {
+    0x10, 0x02, 0x11, 0x00, 0x06, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0, 0xC0,
+    0xE0, 0x70, 0x38, 0x1C, 0x0E, 0x06, 0x00, 0x00, 0x60, 0xC1, 0x07, 0x03,
+    0x07, 0x03, 0x03, 0x07, 0xC1, 0x17, 0x01, 0x60, 0x00,
+};
+
+// 16x16, 32 bytes raw
+const uint8_t img_key[28] = {
+    0x10, 0x02, 0x07, 0xE0, 0xF0, 0x18, 0x08, 0x08, 0x18, 0xF0, 0xE0, 0x86,
+    0xC0, 0x06, 0x00, 0x01, 0x03, 0x02, 0x02, 0x03, 0x01, 0x83, 0x00, 0x80,
+    0x03, 0x01, 0x00, 0x03,
+};
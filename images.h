@@ -0,0 +1,19 @@
+/*
+ * images.h
+ *
+ *  Generated by tools/img_encode.py, do not edit.
+ */
+
+#ifndef IMAGES_H_
+#define IMAGES_H_
+
+#include <stdint.h>
+
+extern const uint8_t img_splash[297];
+extern const uint8_t img_lock_closed[30];
+extern const uint8_t img_lock_open[30];
+extern const uint8_t img_check[27];
+extern const uint8_t img_cross[33];
+extern const uint8_t img_key[28];
+
+#endif /* IMAGES_H_ */
@@ -0,0 +1,338 @@
+/*
+ * keypad.c
+ *
+ *  Port 2 edge interrupts and timer debounce for the keypad encoder, or
+ *  timer-paced scanning of a bare 4x4 matrix with KEYPAD_MATRIX.
+ */
+
+#include "keypad.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "timer.h"
+
+static const char keypad_map[16] = {
+    '1', '2', '3', 'A',
+    '4', '5', '6', 'B',
+    '7', '8', '9', 'C',
+    '*', '0', '#', 'D'
+};
+
+static keypad_event_t keypad_queue[KEYPAD_QUEUE_LEN];
+static volatile uint8_t keypad_head;                    // written by the timer ISR
+static volatile uint8_t keypad_tail;                    // written by the main loop
+static uint8_t keypad_dropped;
+
+static int8_t keypad_timer = TIMER_NONE;
+static uint32_t keypad_edgeAclk;                        // first edge of the change being debounced
+static uint32_t keypad_latencyUs;
+
+// Interrupt context; the event is dropped if the main loop fell that far behind.
+static void keypad_push(char key, uint8_t type) {
+    uint8_t head = keypad_head;
+
+    if ((uint8_t)(head - keypad_tail) >= KEYPAD_QUEUE_LEN) {
+        if (keypad_dropped < 0xFF) {
+            keypad_dropped++;
+        }
+        return;
+    }
+
+    keypad_event_t *ev = &keypad_queue[head & (KEYPAD_QUEUE_LEN - 1)];
+    ev->key = key;
+    ev->type = type;
+    ev->aclk = keypad_edgeAclk;
+    ev->decodeAclk = timer_getAclk();
+    keypad_head = head + 1;
+} // end keypad_push
+
+#if KEYPAD_MATRIX
+/* ====================================================================
+ * 4x4 Matrix
+ *
+ * Idle: all rows driven low, columns pulled up and armed for a falling
+ * edge, no timer running. A column edge starts the periodic scan, which
+ * drives one row low at a time with the others floating, so two keys in
+ * the same column never short two outputs. A key matrix without diodes
+ * shows a phantom fourth key when three corners of a rectangle are held;
+ * such scans are discarded. Once all keys are up the scan timer stops and
+ * the columns are re-armed.
+ * ==================================================================== */
+static uint16_t keypad_raw;                             // last scan, bit = row * 4 + column
+static uint16_t keypad_stable;                          // debounced state
+static uint8_t keypad_agree;                            // consecutive scans equal to keypad_raw
+static uint16_t keypad_ghosts;                          // scans discarded as ambiguous
+static uint32_t keypad_scanStart;                       // ACLK when the current scan run started
+static uint32_t keypad_scanAclk;                        // total ACLK cycles with the scan running
+static uint32_t keypad_initAclk;
+
+static void keypad_armColumns(void) {
+    KEYPAD_ROW_OUT &= ~KEYPAD_ROW_PINS;
+    KEYPAD_ROW_DIR |= KEYPAD_ROW_PINS;                  // all rows low: any key pulls its column down
+    __delay_cycles(KEYPAD_SETTLE_CYCLES);
+    P2IES |= KEYPAD_PINS;                               // falling edge
+    P2IFG &= ~KEYPAD_PINS;
+    P2IE |= KEYPAD_PINS;
+} // end keypad_armColumns
+
+static uint16_t keypad_scanRows(void) {
+    uint16_t keys = 0;
+    uint8_t row;
+
+    KEYPAD_ROW_DIR &= ~KEYPAD_ROW_PINS;                 // float all rows, output latch stays low
+    for (row = 0; row < 4; row++) {
+        KEYPAD_ROW_DIR |= KEYPAD_ROW_FIRST << row;      // drive this row low
+        __delay_cycles(KEYPAD_SETTLE_CYCLES);
+        uint8_t cols = (~P2IN & KEYPAD_PINS) >> 3;      // pressed = low, BIT3 becomes BIT0
+        KEYPAD_ROW_DIR &= ~(KEYPAD_ROW_FIRST << row);
+        keys |= (uint16_t)cols << (row * 4);
+    }
+
+    return keys;
+} // end keypad_scanRows
+
+// Two rows sharing two or more columns: one of the four keys may be a phantom.
+static uint8_t keypad_ghosted(uint16_t keys) {
+    uint8_t i, j;
+
+    for (i = 0; i < 3; i++) {
+        for (j = i + 1; j < 4; j++) {
+            uint8_t common = (keys >> (i * 4)) & (keys >> (j * 4)) & 0x0F;
+            if (common & (common - 1)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+} // end keypad_ghosted
+
+static void keypad_scan(void) {                         // timer callback, interrupt context
+    uint16_t keys = keypad_scanRows();
+
+    if (keys != keypad_raw) {
+        keypad_raw = keys;
+        keypad_agree = 1;
+        keypad_edgeAclk = timer_getAclk();
+    } else if (keypad_agree < KEYPAD_SCAN_DEBOUNCE) {
+        keypad_agree++;
+    }
+
+    if ((keypad_agree == KEYPAD_SCAN_DEBOUNCE) && (keys != keypad_stable)) {
+        if (keypad_ghosted(keys)) {
+            keypad_ghosts++;                            // keep the last unambiguous state
+        } else {
+            uint16_t changed = keys ^ keypad_stable;    // n-key rollover: every key on its own
+            uint8_t k;
+            for (k = 0; k < 16; k++) {
+                if (changed & (1 << k)) {
+                    keypad_push(keypad_map[k], (keys & (1 << k)) ? KEYPAD_PRESS : KEYPAD_RELEASE);
+                }
+            }
+            keypad_stable = keys;
+        }
+    }
+
+    if ((keypad_stable == 0) && (keypad_raw == 0)) {
+        timer_stop(keypad_timer);                       // all keys up: back to interrupt wake-up
+        keypad_timer = TIMER_NONE;
+        keypad_scanAclk += timer_getAclk() - keypad_scanStart;
+        keypad_armColumns();
+    }
+} // end keypad_scan
+
+static void keypad_initLines(void) {
+    // Columns on P2.3-P2.6 with pull-ups, rows on KEYPAD_ROW_PINS.
+    P2SEL &= ~KEYPAD_PINS;
+    P2DIR &= ~KEYPAD_PINS;
+    P2REN |= KEYPAD_PINS;
+    P2OUT |= KEYPAD_PINS;
+    KEYPAD_ROW_SEL &= ~KEYPAD_ROW_PINS;
+
+    keypad_initAclk = timer_getAclk();
+    keypad_armColumns();
+} // end keypad_initLines
+
+// Share of time since keypad_init() the scan timer was running, per mille.
+uint16_t keypad_getScanDuty(void) {
+    uint16_t state = __get_interrupt_state();
+    uint32_t scanning, total;
+
+    __disable_interrupt();
+    uint32_t now = timer_getAclk();
+    scanning = keypad_scanAclk;
+    if (keypad_timer != TIMER_NONE) {
+        scanning += now - keypad_scanStart;
+    }
+    total = now - keypad_initAclk;
+    __set_interrupt_state(state);
+
+    return total ? (uint16_t)(((uint64_t)scanning * 1000) / total) : 0;
+} // end keypad_getScanDuty
+
+uint16_t keypad_getGhosts(void) {
+    return keypad_ghosts;
+} // end keypad_getGhosts
+
+#else
+/* ====================================================================
+ * BCD Encoder
+ * ==================================================================== */
+static char keypad_down;                                // key currently held, 0 if none
+static uint8_t keypad_debouncing;
+
+#define KEYPAD_LINES        (KEYPAD_PINS | KEYPAD_DA_PIN)
+
+static char keypad_decode(void) {
+    return keypad_map[(P2IN & KEYPAD_PINS) >> 3];       // shift by 3 so BIT3 becomes BIT0
+} // end keypad_decode
+
+// Key held according to the lines, 0 if none.
+static char keypad_sample(void) {
+#if KEYPAD_DA_PIN
+    if (!(P2IN & KEYPAD_DA_PIN)) {
+        return 0;                                       // strobe low: no key down
+    }
+#endif
+    return keypad_decode();                             // without the strobe: last latched code
+} // end keypad_sample
+
+// Set each line to interrupt on its next change: falling if now high,
+// rising if now low. Returns nonzero if a line moved while doing so.
+static uint8_t keypad_armEdges(void) {
+    uint8_t in = P2IN & KEYPAD_LINES;
+
+    P2IES = (P2IES & ~KEYPAD_LINES) | in;
+    P2IFG &= ~KEYPAD_LINES;                             // writing P2IES may set P2IFG
+
+    return (P2IN & KEYPAD_LINES) != in;
+} // end keypad_armEdges
+
+static void keypad_settled(void);
+
+// (Re)start the debounce interval; interrupt context or interrupts disabled.
+static void keypad_restartDebounce(void) {
+    timer_stop(keypad_timer);
+    keypad_timer = timer_start(KEYPAD_DEBOUNCE_MS, 0, keypad_settled);
+} // end keypad_restartDebounce
+
+static void keypad_settled(void) {                      // timer callback, interrupt context
+    keypad_timer = TIMER_NONE;
+    if (keypad_armEdges()) {
+        keypad_restartDebounce();                       // still bouncing
+        return;
+    }
+
+    keypad_debouncing = 0;
+    char key = keypad_sample();
+    if (key != keypad_down) {                           // the timer ISR wakes the main loop
+#if KEYPAD_DA_PIN
+        if (keypad_down) {
+            keypad_push(keypad_down, KEYPAD_RELEASE);
+        }
+        if (key) {
+            keypad_push(key, KEYPAD_PRESS);
+        }
+#else
+        if (key) {
+            keypad_push(key, KEYPAD_PRESS);             // no strobe, the release can not be seen:
+            keypad_push(key, KEYPAD_RELEASE);           // report the new code as a tap
+        }
+#endif
+        keypad_down = key;
+    }
+} // end keypad_settled
+
+static void keypad_initLines(void) {
+    // Configure keypad inputs from encoder on P2.3-P2.6 with pull-up resistors.
+    P2SEL &= ~KEYPAD_PINS;
+    P2DIR &= ~KEYPAD_PINS;
+    P2REN |= KEYPAD_PINS;
+    P2OUT |= KEYPAD_PINS;
+#if KEYPAD_DA_PIN
+    P2SEL &= ~KEYPAD_DA_PIN;                            // strobe is driven by the encoder
+    P2DIR &= ~KEYPAD_DA_PIN;
+    P2REN &= ~KEYPAD_DA_PIN;
+#endif
+
+    __delay_cycles(50);                                 // let the pull-ups charge the lines
+    keypad_down = keypad_sample();                      // whatever is latched at boot is not a press
+    keypad_armEdges();
+    P2IE |= KEYPAD_LINES;
+} // end keypad_initLines
+
+#endif /* KEYPAD_MATRIX */
+
+// Requires timer_init().
+void keypad_init(void) {
+    keypad_initLines();
+} // end keypad_init
+
+// Main loop only, single consumer.
+uint8_t keypad_getEvent(keypad_event_t *ev) {
+    uint8_t tail = keypad_tail;
+
+    if (tail == keypad_head) {
+        return 0;
+    }
+
+    *ev = keypad_queue[tail & (KEYPAD_QUEUE_LEN - 1)];
+    keypad_tail = tail + 1;                             // slot handed back after the copy
+    if (ev->type == KEYPAD_PRESS) {
+        keypad_latencyUs = TIMER_ACLK_TO_US(timer_getAclk() - ev->aclk);
+    }
+    return 1;
+} // end keypad_getEvent
+
+char keypad_getKey(void) {
+    keypad_event_t ev;
+
+    while (keypad_getEvent(&ev)) {
+        if (ev.type == KEYPAD_PRESS) {
+            return ev.key;
+        }
+    }
+
+    return 0;
+} // end keypad_getKey
+
+uint8_t keypad_getDropped(void) {
+    return keypad_dropped;
+} // end keypad_getDropped
+
+uint32_t keypad_getLatencyUs(void) {
+    return keypad_latencyUs;
+} // end keypad_getLatencyUs
+
+//------------------------------------------------------------------------------
+// Port 2 edge on an encoder or strobe line: re-arm for the opposite edge and
+// restart the debounce timer. In matrix mode a column went low: stop
+// listening to the columns and start scanning. Does not wake the main loop,
+// the timer will.
+//------------------------------------------------------------------------------
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = PORT2_VECTOR
+__interrupt void PORT2_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(PORT2_VECTOR))) PORT2_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+#if KEYPAD_MATRIX
+    P2IE &= ~KEYPAD_PINS;
+    P2IFG &= ~KEYPAD_PINS;
+    keypad_scanStart = timer_getAclk();
+    keypad_edgeAclk = keypad_scanStart;
+    keypad_timer = timer_start(KEYPAD_SCAN_MS, KEYPAD_SCAN_MS, keypad_scan);
+    if (keypad_timer == TIMER_NONE) {
+        keypad_armColumns();                            // no free timer, wait for the next edge
+    }
+#else
+    if (!keypad_debouncing) {
+        keypad_debouncing = 1;
+        keypad_edgeAclk = timer_getAclk();
+    }
+    keypad_armEdges();
+    keypad_restartDebounce();
+#endif
+}
@@ -0,0 +1,84 @@
+/*
+ * keypad.h
+ *
+ *  Interrupt-driven keypad on the BCD encoder lines P2.3-P2.6.
+ *
+ *  Any edge on an encoder line starts (or restarts) a one-shot debounce
+ *  timer; when the lines have been stable for KEYPAD_DEBOUNCE_MS the key
+ *  state is sampled and press and release events, stamped with the ACLK
+ *  time of the first edge, are queued from interrupt context. Nothing runs
+ *  between key presses, so the CPU stays in LPM3, and keys typed while the
+ *  main loop is busy redrawing are kept in the queue.
+ *
+ *  The encoder latches its outputs, so with the data lines alone a key is
+ *  only seen when the code changes and the same digit twice in a row is
+ *  one press, reported as a press followed at once by its release, since
+ *  the lines never show the key going up. Wire the encoder's
+ *  data-available strobe to Port 2 and set KEYPAD_DA_PIN (e.g.
+ *  -DKEYPAD_DA_PIN=BIT7) to get every press and its real release.
+ *
+ *  With -DKEYPAD_MATRIX=1 the encoder is left out and a bare 4x4 matrix is
+ *  scanned directly: columns on P2.3-P2.6, rows on KEYPAD_ROW_PINS. A
+ *  column interrupt wakes the CPU from LPM3 and starts a scan every
+ *  KEYPAD_SCAN_MS until all keys are up again. Every key is tracked on its
+ *  own (n-key rollover) and ambiguous scans are dropped (ghost detection).
+ */
+
+#ifndef KEYPAD_H_
+#define KEYPAD_H_
+
+#include <stdint.h>
+
+#define KEYPAD_PINS         (BIT3 | BIT4 | BIT5 | BIT6) // encoder outputs on Port 2
+#define KEYPAD_DEBOUNCE_MS  8                           // lines must be stable this long
+#define KEYPAD_QUEUE_LEN    16                          // events, power of two
+
+#ifndef KEYPAD_DA_PIN
+#define KEYPAD_DA_PIN       0                           // data-available strobe on Port 2, 0 = not wired
+#endif
+
+#ifndef KEYPAD_MATRIX
+#define KEYPAD_MATRIX       0
+#endif
+
+#if KEYPAD_MATRIX
+#define KEYPAD_ROW_OUT      P6OUT                       // rows, 1, 4, 7, * first
+#define KEYPAD_ROW_DIR      P6DIR
+#define KEYPAD_ROW_SEL      P6SEL
+#define KEYPAD_ROW_FIRST    BIT0
+#define KEYPAD_ROW_PINS     (BIT0 | BIT1 | BIT2 | BIT3)
+#ifndef KEYPAD_SCAN_MS
+#define KEYPAD_SCAN_MS      10                          // scan period while a key is down
+#endif
+#ifndef KEYPAD_SCAN_DEBOUNCE
+#define KEYPAD_SCAN_DEBOUNCE    2                       // equal scans before a change counts
+#endif
+#define KEYPAD_SETTLE_CYCLES    20                      // column pull-up settling after a row change
+#endif
+
+#define KEYPAD_HAS_RELEASE  (KEYPAD_MATRIX || KEYPAD_DA_PIN)  // releases follow the key, not the press
+
+#define KEYPAD_PRESS        1
+#define KEYPAD_RELEASE      0
+
+typedef struct {
+    char key;
+    uint8_t type;                                       // KEYPAD_PRESS or KEYPAD_RELEASE
+    uint32_t aclk;                                      // timer_getAclk() at the first edge
+    uint32_t decodeAclk;                                // timer_getAclk() when debounced and queued
+} keypad_event_t;
+
+/* ====================================================================
+ * Keypad Prototype Definitions
+ * ==================================================================== */
+void keypad_init(void);
+uint8_t keypad_getEvent(keypad_event_t *);              // 1 if an event was taken from the queue
+char keypad_getKey(void);                               // next key press, release events skipped; 0 if none
+uint8_t keypad_getDropped(void);                        // events lost to a full queue
+uint32_t keypad_getLatencyUs(void);                     // first edge to main loop pick-up of the last press
+#if KEYPAD_MATRIX
+uint16_t keypad_getScanDuty(void);                      // per mille of the time spent scanning
+uint16_t keypad_getGhosts(void);                        // scans discarded as ambiguous
+#endif
+
+#endif /* KEYPAD_H_ */
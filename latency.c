@@ -0,0 +1,176 @@
+/*
+ * latency.c
+ *
+ *  Per-stage keypress-to-pixel latency statistics.
+ */
+
+#include "latency.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+
+#if LATENCY_TRACE
+
+typedef struct {
+    uint16_t count;
+    uint32_t min;                                       // ACLK cycles
+    uint32_t max;
+    uint32_t sum;
+    uint16_t hist[LATENCY_BUCKETS];
+} latency_stage_t;
+
+static latency_stage_t latency_stages[LATENCY_STAGES];
+
+static uint8_t latency_active;                          // a press is being traced
+static uint8_t latency_drawing;
+static uint32_t latency_edge;
+static uint32_t latency_decode;
+static uint32_t latency_handle;
+static uint32_t latency_draw;
+
+static const char *const latency_names[LATENCY_STAGES] = {
+    "DBNC", "QUEU", "LOGC", "DRAW", "TOTL"
+};
+
+// Four buckets per octave: exact below 4, then 4 + 4 * (msb - 2) + next two bits.
+static uint8_t latency_bucket(uint32_t v) {
+    uint8_t msb = 0;
+    uint32_t t;
+
+    if (v < 4) {
+        return (uint8_t)v;
+    }
+    for (t = v; t > 1; t >>= 1) {
+        msb++;
+    }
+
+    uint8_t idx = 4 * (msb - 1) + ((v >> (msb - 2)) & 0x3);
+    return (idx < LATENCY_BUCKETS) ? idx : (LATENCY_BUCKETS - 1);
+} // end latency_bucket
+
+// Largest value that falls into bucket idx.
+static uint32_t latency_bucketTop(uint8_t idx) {
+    if (idx < 4) {
+        return idx;
+    }
+
+    uint8_t msb = idx / 4 + 1;
+    uint32_t low = (uint32_t)(4 + (idx & 0x3)) << (msb - 2);
+    return low + ((uint32_t)1 << (msb - 2)) - 1;
+} // end latency_bucketTop
+
+static void latency_add(uint8_t stage, uint32_t aclk) {
+    latency_stage_t *s = &latency_stages[stage];
+
+    if (s->count == 0xFFFF) {
+        return;                                         // saturated, reset to start over
+    }
+    if (!s->count || (aclk < s->min)) {
+        s->min = aclk;
+    }
+    if (aclk > s->max) {
+        s->max = aclk;
+    }
+    s->sum += aclk;
+    s->count++;
+    s->hist[latency_bucket(aclk)]++;
+} // end latency_add
+
+void latency_begin(uint32_t edgeAclk, uint32_t decodeAclk) {
+    latency_edge = edgeAclk;
+    latency_decode = decodeAclk;
+    latency_handle = timer_getAclk();
+    latency_active = 1;                                 // replaces a press that drew nothing
+    latency_drawing = 0;
+} // end latency_begin
+
+void latency_drawStart(void) {
+    if (latency_active && !latency_drawing) {
+        latency_draw = timer_getAclk();
+        latency_drawing = 1;
+    }
+} // end latency_drawStart
+
+void latency_drawDone(void) {
+    if (!latency_drawing) {
+        return;
+    }
+
+    uint32_t done = timer_getAclk();
+    latency_add(LATENCY_DEBOUNCE, latency_decode - latency_edge);
+    latency_add(LATENCY_QUEUE, latency_handle - latency_decode);
+    latency_add(LATENCY_LOGIC, latency_draw - latency_handle);
+    latency_add(LATENCY_DRAW, done - latency_draw);
+    latency_add(LATENCY_TOTAL, done - latency_edge);
+    latency_active = 0;
+    latency_drawing = 0;
+} // end latency_drawDone
+
+void latency_getStats(uint8_t stage, latency_stats_t *stats) {
+    const latency_stage_t *s = &latency_stages[stage];
+
+    stats->count = s->count;
+    if (!s->count) {
+        stats->minUs = stats->meanUs = stats->maxUs = stats->p99Us = 0;
+        return;
+    }
+
+    uint16_t rank = s->count - s->count / 100;          // samples at or below p99
+    uint16_t seen = 0;
+    uint8_t idx;
+    for (idx = 0; idx < LATENCY_BUCKETS - 1; idx++) {
+        seen += s->hist[idx];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    uint32_t p99 = latency_bucketTop(idx);
+    if (p99 > s->max) {
+        p99 = s->max;
+    }
+
+    stats->minUs = TIMER_ACLK_TO_US(s->min);
+    stats->meanUs = TIMER_ACLK_TO_US(s->sum / s->count);
+    stats->maxUs = TIMER_ACLK_TO_US(s->max);
+    stats->p99Us = TIMER_ACLK_TO_US(p99);
+} // end latency_getStats
+
+// "TOTL 12 14 31 30" per stage: name, then min, mean, max and p99 in
+// tenths of a millisecond, fitting the 21 console columns.
+void latency_dump(latency_sink_t sink) {
+    char line[32];
+    latency_stats_t st;
+    uint8_t stage;
+
+    latency_getStats(LATENCY_TOTAL, &st);
+    snprintf(line, sizeof(line), "n=%u  x0.1ms", st.count);
+    sink(line);
+    sink("     min mean max p99");
+
+    for (stage = 0; stage < LATENCY_STAGES; stage++) {
+        latency_getStats(stage, &st);
+        snprintf(line, sizeof(line), "%s%4lu%4lu%4lu%4lu", latency_names[stage],
+                 (unsigned long)((st.minUs + 50) / 100), (unsigned long)((st.meanUs + 50) / 100),
+                 (unsigned long)((st.maxUs + 50) / 100), (unsigned long)((st.p99Us + 50) / 100));
+        sink(line);
+    }
+} // end latency_dump
+
+void latency_reset(void) {
+    uint8_t stage;
+    uint8_t i;
+
+    for (stage = 0; stage < LATENCY_STAGES; stage++) {
+        latency_stage_t *s = &latency_stages[stage];
+        s->count = 0;
+        s->min = s->max = s->sum = 0;
+        for (i = 0; i < LATENCY_BUCKETS; i++) {
+            s->hist[i] = 0;
+        }
+    }
+    latency_active = 0;
+    latency_drawing = 0;
+} // end latency_reset
+
+#endif /* LATENCY_TRACE */
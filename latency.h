@@ -0,0 +1,61 @@
+/*
+ * latency.h
+ *
+ *  Keypress-to-pixel latency, split into stages.
+ *
+ *  One key press at a time is traced with ACLK timestamps (30.5us
+ *  resolution): first edge on P2, debounced decode, pick-up by the main
+ *  loop, displayMessage() start and the last I2C byte of the redraw. The
+ *  time spent in each stage, and end to end, is kept as min, mean, max and
+ *  an approximate p99 from a histogram with four buckets per octave
+ *  (within ~19%). A press that causes no redraw is not counted.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE       1                           // 0 compiles the hooks out
+#endif
+
+#define LATENCY_DEBOUNCE    0                           // edge -> decoded
+#define LATENCY_QUEUE       1                           // decoded -> main loop
+#define LATENCY_LOGIC       2                           // main loop -> displayMessage()
+#define LATENCY_DRAW        3                           // displayMessage() -> last I2C byte
+#define LATENCY_TOTAL       4                           // edge -> last I2C byte
+#define LATENCY_STAGES      5
+
+#define LATENCY_BUCKETS     72                          // up to 2^19 ACLK cycles, 16s
+
+typedef struct {
+    uint16_t count;
+    uint32_t minUs;
+    uint32_t meanUs;
+    uint32_t maxUs;
+    uint32_t p99Us;
+} latency_stats_t;
+
+typedef void (*latency_sink_t)(const char *);
+
+/* ====================================================================
+ * Latency Prototype Definitions
+ * ==================================================================== */
+#if LATENCY_TRACE
+void latency_begin(uint32_t, uint32_t);                 // edge and decode ACLK of the press being handled
+void latency_drawStart(void);
+void latency_drawDone(void);
+void latency_getStats(uint8_t, latency_stats_t *);
+void latency_dump(latency_sink_t);                      // one line per stage, e.g. console_println
+void latency_reset(void);
+#else
+#define latency_begin(edge, decode)
+#define latency_drawStart()
+#define latency_drawDone()
+#define latency_getStats(stage, stats)
+#define latency_dump(sink)
+#define latency_reset()
+#endif
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,210 @@
+/*
+ * led.c
+ *
+ *  Timer_A0 PWM for the status LEDs, pattern steps by DMA from Timer_A1.
+ */
+
+#include "led.h"
+#include <msp430.h>
+#include <stdint.h>
+
+#define LED_PINS            (BIT4 | BIT5)
+#define LED_TA0_PINS        (BIT2 | BIT3 | BIT4 | BIT5) // P1, TA0.1 to TA0.4
+#define LED_TA1_PINS        (BIT0 | BIT1)               // P2, TA1.1 and TA1.2
+#define LED_L(level)        (LED_PWM_PERIOD - (level))  // set/reset compare value, above TA0CCR0 = off
+
+// DMA addresses are 20 bits; the tables and Timer_A registers are all
+// below 64KB, where a word write (clearing bits 19-16) is enough.
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#define LED_DMA_ADDR(reg, addr)     __data16_write_addr((unsigned short)&(reg), (unsigned long)(addr))
+#elif defined(__GNUC__)
+#define LED_DMA_ADDR(reg, addr)     (*(volatile uint16_t *)&(reg) = (uint16_t)(uintptr_t)(addr))
+#else
+#error Compiler not supported!
+#endif
+
+typedef struct {
+    const uint16_t *steps;
+    uint8_t length;
+} led_pattern_t;
+
+static const uint16_t led_blink[] = {                   // 1Hz, half on
+    LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64),
+    LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64),
+    LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+};
+
+static const uint16_t led_flash[] = {                   // 120ms on, 120ms off
+    LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L(64), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0),
+};
+
+static const uint16_t led_breathe[] = {                 // 2s raised cosine
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 1), LED_L( 1), LED_L( 1), LED_L( 1), LED_L( 2), LED_L( 3), LED_L( 3), LED_L( 4), LED_L( 5),
+    LED_L( 6), LED_L( 7), LED_L( 9), LED_L(10), LED_L(12), LED_L(14), LED_L(16), LED_L(18), LED_L(20), LED_L(23),
+    LED_L(25), LED_L(28), LED_L(30), LED_L(33), LED_L(36), LED_L(39), LED_L(41), LED_L(44), LED_L(46), LED_L(49),
+    LED_L(51), LED_L(54), LED_L(56), LED_L(57), LED_L(59), LED_L(61), LED_L(62), LED_L(63), LED_L(63), LED_L(64),
+    LED_L(64), LED_L(64), LED_L(63), LED_L(63), LED_L(62), LED_L(61), LED_L(59), LED_L(57), LED_L(56), LED_L(54),
+    LED_L(51), LED_L(49), LED_L(46), LED_L(44), LED_L(41), LED_L(39), LED_L(36), LED_L(33), LED_L(30), LED_L(28),
+    LED_L(25), LED_L(23), LED_L(20), LED_L(18), LED_L(16), LED_L(14), LED_L(12), LED_L(10), LED_L( 9), LED_L( 7),
+    LED_L( 6), LED_L( 5), LED_L( 4), LED_L( 3), LED_L( 3), LED_L( 2), LED_L( 1), LED_L( 1), LED_L( 1), LED_L( 1),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+};
+
+static const uint16_t led_pulse[] = {                   // 1s: flash, decay, rest
+    LED_L(14), LED_L(64), LED_L(64), LED_L(41), LED_L(27), LED_L(17), LED_L(11), LED_L( 7), LED_L( 5), LED_L( 3),
+    LED_L( 2), LED_L( 1), LED_L( 1), LED_L( 1), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+    LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0), LED_L( 0),
+};
+
+static const led_pattern_t led_patterns[LED_PATTERNS] = {
+    { led_blink,   sizeof(led_blink) / sizeof(led_blink[0])     },
+    { led_flash,   sizeof(led_flash) / sizeof(led_flash[0])     },
+    { led_breathe, sizeof(led_breathe) / sizeof(led_breathe[0]) },
+    { led_pulse,   sizeof(led_pulse) / sizeof(led_pulse[0])     },
+};
+
+static const uint8_t led_bits[LED_COUNT] = { BIT4, BIT5 };
+static uint8_t led_steady[LED_COUNT];                   // level outside patterns
+static volatile uint8_t led_cycles[LED_COUNT];          // pattern cycles left, LED_FOREVER
+static volatile uint8_t led_playing;                    // bit per LED
+static volatile uint16_t led_wakeups;
+
+// Timer_A0 only while one of its outputs is in use, Timer_A1 also while a
+// pattern plays.
+void led_updateTimers(void) {
+    if (P1SEL & LED_TA0_PINS) {
+        TA0CTL |= MC_1;                         // up mode
+    } else {
+        TA0CTL &= ~MC_3;                        // stop
+    }
+    if (led_playing || (P2SEL & LED_TA1_PINS)) {
+        TA1CTL |= MC_1;
+    } else {
+        TA1CTL &= ~MC_3;
+    }
+} // end led_updateTimers
+
+static void led_apply(uint8_t led, uint8_t level) {
+    uint8_t bit = led_bits[led];
+
+    if ((level == 0) || (level >= LED_LEVEL_MAX)) {
+        P1SEL &= ~bit;                          // plain GPIO for off and full on
+        if (level) {
+            P1OUT |= bit;
+        } else {
+            P1OUT &= ~bit;
+        }
+    } else {
+        if (led == LED_LOCKED) {
+            TA0CCR3 = LED_L(level);
+        } else {
+            TA0CCR4 = LED_L(level);
+        }
+        P1SEL |= bit;                           // TA0.3 / TA0.4 output
+    }
+    led_updateTimers();
+} // end led_apply
+
+static void led_stop(uint8_t led) {
+    if (led == LED_LOCKED) {
+        DMA0CTL = 0;
+    } else {
+        DMA1CTL = 0;
+    }
+    led_playing &= ~(1 << led);
+} // end led_stop
+
+void led_init(void) {
+    P1OUT &= ~LED_PINS;
+    P1DIR |= LED_PINS;
+    P1SEL &= ~LED_PINS;
+
+    TA0CTL = TASSEL_1 + TACLR;                  // ACLK, stopped until an LED needs PWM
+    TA0CCR0 = LED_PWM_PERIOD - 1;
+    TA0CCTL3 = OUTMOD_3;                        // set at TA0CCR3, reset at TA0CCR0
+    TA0CCTL4 = OUTMOD_3;
+
+    TA1CTL = TASSEL_1 + TACLR;                  // ACLK, stopped until a pattern plays
+    TA1CCR0 = LED_STEP_ACLK - 1;
+
+    DMACTL0 = DMA0TSEL_3 + DMA1TSEL_3;          // both channels on TA1CCR0 CCIFG
+} // end led_init
+
+void led_set(uint8_t led, uint8_t level) {
+    led_stop(led);
+    led_steady[led] = level;
+    led_apply(led, level);
+} // end led_set
+
+// Repeated single transfers: one table entry per TA1CCR0, the DMA
+// reloads the table address and count by itself after the last entry.
+void led_play(uint8_t led, uint8_t pattern, uint8_t cycles) {
+    const led_pattern_t *p = &led_patterns[pattern];
+
+    led_stop(led);
+    led_cycles[led] = cycles;
+    led_apply(led, 1);                          // onto PWM, dark until the first step
+
+    if (led == LED_LOCKED) {
+        LED_DMA_ADDR(DMA0SA, p->steps);
+        LED_DMA_ADDR(DMA0DA, &TA0CCR3);
+        DMA0SZ = p->length;
+        DMA0CTL = DMADT_4 + DMASRCINCR_3 + DMADSTINCR_0 + DMAIE + DMAEN;
+    } else {
+        LED_DMA_ADDR(DMA1SA, p->steps);
+        LED_DMA_ADDR(DMA1DA, &TA0CCR4);
+        DMA1SZ = p->length;
+        DMA1CTL = DMADT_4 + DMASRCINCR_3 + DMADSTINCR_0 + DMAIE + DMAEN;
+    }
+
+    led_playing |= 1 << led;
+    led_updateTimers();
+} // end led_play
+
+uint8_t led_isPlaying(uint8_t led) {
+    return (led_playing >> led) & 0x1;
+} // end led_isPlaying
+
+uint16_t led_getWakeups(void) {
+    return led_wakeups;
+} // end led_getWakeups
+
+// One pass through a pattern table is done.
+static void led_cycleDone(uint8_t led) {
+    led_wakeups++;
+    if (led_cycles[led] && !--led_cycles[led]) {
+        led_stop(led);
+        led_apply(led, led_steady[led]);
+    }
+} // end led_cycleDone
+
+//------------------------------------------------------------------------------
+// DMA interrupt: end of a pattern table. Does not wake the main loop, the
+// CPU goes straight back to the low power mode it was in.
+//------------------------------------------------------------------------------
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = DMA_VECTOR
+__interrupt void DMA_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(DMA_VECTOR))) DMA_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    switch (__even_in_range(DMAIV, 16)) {
+    case 2:                                     // DMA0IFG
+        led_cycleDone(LED_LOCKED);
+        break;
+    case 4:                                     // DMA1IFG
+        led_cycleDone(LED_UNLOCKED);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * led.h
+ *
+ *  Status LED brightness and patterns on Timer_A PWM, played by DMA.
+ *
+ *  P1.4 (TA0.3) and P1.5 (TA0.4) are driven by Timer_A0 PWM from ACLK,
+ *  LED_PWM_PERIOD counts per period (512Hz), so 0 to LED_LEVEL_MAX
+ *  brightness levels. A steady 0 or LED_LEVEL_MAX puts the pin back to
+ *  plain GPIO and stops Timer_A0 once neither LED needs it.
+ *
+ *  A pattern is a table of levels, one per LED_STEP_MS, in flash. Timer_A1
+ *  triggers one DMA transfer per step from the table into the LED's
+ *  compare register, repeating the table until led_set() or until the
+ *  requested number of cycles is done. The CPU is only involved once per
+ *  cycle, in the DMA interrupt, and can stay in LPM3 in between: the DMA
+ *  requests MCLK for each transfer on its own (UCSCTL8 MCLKREQEN, set
+ *  by default).
+ *
+ *  The other outputs of both timers are free for other modules on the same
+ *  periods: TA0.1/TA0.2 (P1.2/P1.3) at the PWM period, TA1.1/TA1.2
+ *  (P2.0/P2.1) at the 20ms step, e.g. the lock actuator. A timer runs while
+ *  any of its output pins is selected; call led_updateTimers() after
+ *  changing P1SEL or P2SEL for one of them.
+ */
+
+#ifndef LED_H_
+#define LED_H_
+
+#include <stdint.h>
+
+#define LED_LOCKED          0                           // P1.4, TA0.3, DMA channel 0
+#define LED_UNLOCKED        1                           // P1.5, TA0.4, DMA channel 1
+#define LED_COUNT           2
+
+#define LED_PWM_PERIOD      64                          // ACLK counts, 512Hz
+#define LED_LEVEL_MAX       LED_PWM_PERIOD
+#define LED_STEP_MS         20                          // pattern resolution
+#define LED_STEP_ACLK       655                         // LED_STEP_MS in ACLK counts
+
+#define LED_PATTERN_BLINK   0                           // 1Hz, half on
+#define LED_PATTERN_FLASH   1                           // 120ms on, 120ms off
+#define LED_PATTERN_BREATHE 2                           // 2s fade in and out, gamma corrected
+#define LED_PATTERN_PULSE   3                           // 1s: short flash and decay
+#define LED_PATTERNS        4
+
+#define LED_FOREVER         0                           // cycles: until led_set()
+
+/* ====================================================================
+ * LED Prototype Definitions
+ * ==================================================================== */
+void led_init(void);
+void led_set(uint8_t, uint8_t);                         // LED, level 0..LED_LEVEL_MAX; ends a pattern
+void led_play(uint8_t, uint8_t, uint8_t);               // LED, pattern, cycles; then back to the led_set() level
+uint8_t led_isPlaying(uint8_t);
+uint16_t led_getWakeups(void);                          // DMA interrupts so far, the only CPU time patterns take
+void led_updateTimers(void);                            // start or stop Timer_A0/A1 for their current users
+
+#endif /* LED_H_ */
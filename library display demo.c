@@ -26,8 +26,8 @@
 #include "i2c.h"
 #include "clock.h"
 
-extern unsigned char *PTxData;                  // Pointer to TX data, defined in i2c.h
-extern unsigned char TXByteCtr;                 // number of bytes to transmit, defined in i2c.h
+extern unsigned char *PTxData;                  // Pointer to TX data, defined in i2c.c
+extern volatile unsigned char TXByteCtr;        // number of bytes to transmit, defined in i2c.c
 
 #define MAX_COUNT 4294967295UL
 
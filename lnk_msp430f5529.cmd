@@ -63,7 +63,9 @@ MEMORY
     INFOC                   : origin = 0x1880, length = 0x0080
     INFOD                   : origin = 0x1800, length = 0x0080
     FLASH                   : origin = 0x4400, length = 0xBB80
-    FLASH2                  : origin = 0x10000,length = 0x14400
+    FLASH2                  : origin = 0x10000,length = 0x2400
+    AUDIT                   : origin = 0x12400,length = 0x2000 /* audit log, see audit.h */
+    CREDS                   : origin = 0x14400,length = 0x10000 /* credential store, see creds.h */
     INT00                   : origin = 0xFF80, length = 0x0002
     INT01                   : origin = 0xFF82, length = 0x0002
     INT02                   : origin = 0xFF84, length = 0x0002
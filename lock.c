@@ -0,0 +1,439 @@
+/*
+ * lock.c
+ *
+ *  Lock behaviour as a state x event transition table.
+ */
+
+#include "lock.h"
+#include <stdint.h>
+#include <string.h>
+#include "timer.h"
+#include "power.h"
+#include "creds.h"
+#include "settings.h"
+#include "audit.h"
+
+typedef uint8_t (*lock_guard_t)(void);
+typedef void (*lock_action_t)(void);
+
+typedef struct {
+    lock_guard_t guard;                                 // 0 = always
+    lock_action_t action;                               // 0 = none
+    uint8_t next;                                       // state, or LOCK_STAY
+} lock_transition_t;
+
+typedef struct {
+    lock_action_t entry;
+    lock_action_t exit;
+    uint32_t timeoutMs;                                 // 0 = none, LOCK_BACKOFF = current backoff
+} lock_state_t;
+
+#define LOCK_BACKOFF        0xFFFFFFFFUL
+
+static char lock_enteredPin[LOCK_PIN_MAX + 1];
+static uint8_t lock_index;                              // digits in lock_enteredPin
+static char lock_lastKey;                               // key behind the event being dispatched
+
+static uint8_t lock_state = LOCK_UNLOCKED;
+static uint8_t lock_raised = LOCK_EV_NONE;              // event raised by an action, dispatched next
+static int8_t lock_timer = TIMER_NONE;
+static volatile uint8_t lock_timeoutDue;
+
+static uint16_t lock_failures;                          // persisted as SETTINGS_ID_FAILURES
+static creds_user_t lock_user = { CREDS_DEFAULT_USER, CREDS_ROLE_ADMIN };  // unlocked last, SETTINGS_ID_USER
+static uint8_t lock_storeResult;                        // creds_replace() of the last set-PIN
+static uint32_t lock_lockoutEnd;                        // now_ms() the lockout ends
+static int8_t lock_countdownTimer = TIMER_NONE;
+static volatile uint8_t lock_countdownDue;
+
+// Lockout for the current failure count: LOCK_BACKOFF_MS at
+// LOCK_FREE_ATTEMPTS, doubling per failure after that.
+static uint32_t lock_backoffMs(void) {
+    uint32_t ms = LOCK_BACKOFF_MS;
+    uint16_t n;
+
+    for (n = LOCK_FREE_ATTEMPTS; (n < lock_failures) && (ms < LOCK_BACKOFF_MAX_MS); n++) {
+        ms <<= 1;
+    }
+    return (ms < LOCK_BACKOFF_MAX_MS) ? ms : LOCK_BACKOFF_MAX_MS;
+} // end lock_backoffMs
+
+static void lock_setFailures(uint16_t failures) {
+    lock_failures = failures;
+    settings_write(SETTINGS_ID_FAILURES, &lock_failures, sizeof(lock_failures));
+} // end lock_setFailures
+
+/* ====================================================================
+ * Guards
+ * ==================================================================== */
+static uint8_t lock_hasRoom(void) {
+    return lock_index < LOCK_PIN_MAX;
+} // end lock_hasRoom
+
+static uint8_t lock_hasDigits(void) {
+    return lock_index > 0;
+} // end lock_hasDigits
+
+static uint8_t lock_pinComplete(void) {
+    return lock_index >= LOCK_PIN_MIN;
+} // end lock_pinComplete
+
+/* ====================================================================
+ * Actions
+ * ==================================================================== */
+static void lock_clearPin(void) {
+    lock_index = 0;
+    memset(lock_enteredPin, 0, sizeof(lock_enteredPin));
+} // end lock_clearPin
+
+static void lock_appendDigit(void) {
+    lock_enteredPin[lock_index++] = lock_lastKey;
+    lock_enteredPin[lock_index] = '\0';
+    lock_showPinMask(lock_index);                       // one mask glyph, never the digit
+} // end lock_appendDigit
+
+static void lock_backspace(void) {
+    lock_enteredPin[--lock_index] = '\0';
+    lock_showPinMask(lock_index);
+} // end lock_backspace
+
+// Replace the PIN of whoever unlocked last, the default admin on a new
+// lock, so old PINs stop working. The first PIN set by any other user
+// also retires the default one.
+static void lock_storePin(void) {
+    lock_storeResult = creds_replace(lock_enteredPin, lock_user.userId, lock_user.role);
+
+    if (lock_storeResult == CREDS_OK) {
+        if (lock_user.userId != CREDS_DEFAULT_USER) {
+            creds_revoke(CREDS_DEFAULT_PIN);            // CREDS_ERR_NOTFOUND once it is gone
+        }
+        audit_log(AUDIT_EV_PIN_ADDED, 0, lock_user.userId);
+
+        settings_pinLog_t log = { 0, 0 };
+        settings_read(SETTINGS_ID_PIN_LOG, &log, sizeof(log));
+        log.changes++;
+        log.lastUser = lock_user.userId;
+        settings_write(SETTINGS_ID_PIN_LOG, &log, sizeof(log));
+    }
+    lock_raised = (lock_storeResult == CREDS_OK) ? LOCK_EV_PIN_OK : LOCK_EV_PIN_BAD;
+} // end lock_storePin
+
+static void lock_storeFailed(void) {
+    lock_clearPin();
+    lock_showMessage((lock_storeResult == CREDS_ERR_DUP) ? "PIN in use. New PIN, then #" :
+                                                           "PIN store full. New PIN, then #");
+} // end lock_storeFailed
+
+// Counts the attempt before raising the result, so a reset right after a
+// wrong PIN can not be used to skip its lockout.
+static void lock_checkPin(void) {
+    uint8_t sub = power_begin(POWER_SUB_CRYPTO);
+    creds_user_t user;
+    uint8_t match = (creds_lookup(lock_enteredPin, &user) == CREDS_OK);   // salted hash, constant-time compare
+    power_end(sub);
+
+    if (match) {
+        if (lock_failures) {
+            lock_setFailures(0);
+        }
+        lock_user = user;
+        settings_write(SETTINGS_ID_USER, &lock_user, sizeof(lock_user));   // set-PIN after a reset
+        audit_log(AUDIT_EV_UNLOCK, 0, user.userId);
+        lock_raised = LOCK_EV_PIN_OK;
+    } else {
+        if (lock_failures < 0xFFFF) {
+            lock_setFailures(lock_failures + 1);
+        }
+        lock_raised = (lock_failures >= LOCK_FREE_ATTEMPTS) ? LOCK_EV_LOCKOUT : LOCK_EV_PIN_BAD;
+        audit_log((lock_raised == LOCK_EV_LOCKOUT) ? AUDIT_EV_LOCKOUT : AUDIT_EV_WRONG_PIN,
+                  (lock_failures < 0xFF) ? lock_failures : 0xFF, 0);
+    }
+} // end lock_checkPin
+
+static void lock_auditLock(void) {
+    audit_log(AUDIT_EV_LOCK, 0, 0);
+} // end lock_auditLock
+
+static void lock_enterUnlocked(void) {
+    lock_showMessage("Unlocked. Press A to set PIN");
+    setLockedLEDOff();
+    setUnlockedLEDOn();
+} // end lock_enterUnlocked
+
+static void lock_enterSetPin(void) {
+    lock_clearPin();
+    lock_showMessage("New PIN (4-8 digits), then #");
+    setLockedLEDOff();
+    setUnlockedLEDOff();
+} // end lock_enterSetPin
+
+static void lock_enterLocked(void) {
+    lock_showMessage("Locked. Press C to enter PIN");
+    setLockedLEDOn();
+    setUnlockedLEDOff();
+    lock_actuateLock();
+} // end lock_enterLocked
+
+static void lock_enterEnterPin(void) {
+    lock_clearPin();
+    lock_showMessage("Enter PIN, then press #");
+    setLockedLEDOn();
+    setUnlockedLEDOff();
+} // end lock_enterEnterPin
+
+static void lock_enterWrongPin(void) {
+    lock_showMessage("Wrong PIN! Press C to try again");
+    lock_alarmDisplay();
+    setLockedLEDOn();
+    setUnlockedLEDOff();
+    flashLockedLED();                                   // after setLockedLEDOn(), which cancels flashing
+} // end lock_enterWrongPin
+
+static void lock_countdown(void) {
+    lock_countdownDue = 1;                              // timer callback, interrupt context
+} // end lock_countdown
+
+// Seconds to the end of the lockout, rounded up. The difference is taken
+// before the sign test so it survives now_ms() wrapping.
+static void lock_showCountdown(void) {
+    int32_t left = (int32_t)(lock_lockoutEnd - now_ms());
+
+    lock_showSeconds((left > 0) ? (uint16_t)((left + 999) / 1000) : 0);    // < LOCK_BACKOFF_MAX_MS
+} // end lock_showCountdown
+
+static void lock_enterLockout(void) {
+    lock_lockoutEnd = now_ms() + lock_backoffMs();
+    lock_showMessage("Too many wrong PINs. Wait");
+    lock_showCountdown();
+    lock_alarmDisplay();
+    setLockedLEDOn();
+    setUnlockedLEDOff();
+    flashLockedLED();
+    lock_countdownTimer = timer_start(LOCK_COUNTDOWN_MS, LOCK_COUNTDOWN_MS, lock_countdown);
+} // end lock_enterLockout
+
+static void lock_exitLockout(void) {
+    timer_stop(lock_countdownTimer);
+    lock_countdownTimer = TIMER_NONE;
+    lock_countdownDue = 0;
+} // end lock_exitLockout
+
+/* ====================================================================
+ * Tables, in flash
+ * ==================================================================== */
+static const lock_state_t lock_states[LOCK_STATES] = {
+    /* LOCK_UNLOCKED  */ { lock_enterUnlocked, 0,                LOCK_RELOCK_MS },
+    /* LOCK_SET_PIN   */ { lock_enterSetPin,   lock_clearPin,    LOCK_ENTRY_MS  },
+    /* LOCK_LOCKED    */ { lock_enterLocked,   0,                0              },
+    /* LOCK_ENTER_PIN */ { lock_enterEnterPin, lock_clearPin,    LOCK_ENTRY_MS  },
+    /* LOCK_WRONG_PIN */ { lock_enterWrongPin, 0,                0              },
+    /* LOCK_LOCKOUT   */ { lock_enterLockout,  lock_exitLockout, LOCK_BACKOFF   },
+};
+
+#define LOCK_IGNORE         { 0, 0, LOCK_STAY }
+
+static const lock_transition_t lock_table[LOCK_STATES][LOCK_EVENTS] = {
+    /* LOCK_UNLOCKED */ {
+        /* DIGIT   */ LOCK_IGNORE,
+        /* A       */ { 0, 0, LOCK_SET_PIN },
+        /* C       */ LOCK_IGNORE,
+        /* TIMEOUT */ { 0, lock_auditLock, LOCK_LOCKED },   // relock
+        /* PIN_OK  */ LOCK_IGNORE,
+        /* PIN_BAD */ LOCK_IGNORE,
+        /* LOCKOUT */ LOCK_IGNORE,
+        /* BKSPACE */ LOCK_IGNORE,
+        /* SUBMIT  */ LOCK_IGNORE,
+        /* RELOCK  */ { 0, lock_auditLock, LOCK_LOCKED },   // dwell over, follow the door
+    },
+    /* LOCK_SET_PIN */ {
+        /* DIGIT   */ { lock_hasRoom, lock_appendDigit, LOCK_STAY },
+        /* A       */ LOCK_IGNORE,
+        /* C       */ LOCK_IGNORE,
+        /* TIMEOUT */ { 0, lock_auditLock, LOCK_LOCKED },   // abandoned, the door relocked meanwhile
+        /* PIN_OK  */ { 0, lock_auditLock, LOCK_LOCKED },   // stored
+        /* PIN_BAD */ { 0, lock_storeFailed, LOCK_STAY },
+        /* LOCKOUT */ LOCK_IGNORE,
+        /* BKSPACE */ { lock_hasDigits, lock_backspace, LOCK_STAY },
+        /* SUBMIT  */ { lock_pinComplete, lock_storePin, LOCK_STAY },
+        /* RELOCK  */ LOCK_IGNORE,                      // door shut, the new PIN can still be entered
+    },
+    /* LOCK_LOCKED */ {
+        /* DIGIT   */ LOCK_IGNORE,
+        /* A       */ LOCK_IGNORE,
+        /* C       */ { 0, 0, LOCK_ENTER_PIN },
+        /* TIMEOUT */ LOCK_IGNORE,
+        /* PIN_OK  */ LOCK_IGNORE,
+        /* PIN_BAD */ LOCK_IGNORE,
+        /* LOCKOUT */ LOCK_IGNORE,
+        /* BKSPACE */ LOCK_IGNORE,
+        /* SUBMIT  */ LOCK_IGNORE,
+        /* RELOCK  */ LOCK_IGNORE,
+    },
+    /* LOCK_ENTER_PIN */ {
+        /* DIGIT   */ { lock_hasRoom, lock_appendDigit, LOCK_STAY },
+        /* A       */ LOCK_IGNORE,
+        /* C       */ LOCK_IGNORE,
+        /* TIMEOUT */ { 0, 0, LOCK_LOCKED },
+        /* PIN_OK  */ { 0, lock_actuateUnlock, LOCK_UNLOCKED },   // not on resume after a reset
+        /* PIN_BAD */ { 0, 0, LOCK_WRONG_PIN },
+        /* LOCKOUT */ { 0, 0, LOCK_LOCKOUT },
+        /* BKSPACE */ { lock_hasDigits, lock_backspace, LOCK_STAY },
+        /* SUBMIT  */ { lock_pinComplete, lock_checkPin, LOCK_STAY },
+        /* RELOCK  */ LOCK_IGNORE,
+    },
+    /* LOCK_WRONG_PIN */ {
+        /* DIGIT   */ LOCK_IGNORE,
+        /* A       */ LOCK_IGNORE,
+        /* C       */ { 0, 0, LOCK_ENTER_PIN },
+        /* TIMEOUT */ LOCK_IGNORE,
+        /* PIN_OK  */ LOCK_IGNORE,
+        /* PIN_BAD */ LOCK_IGNORE,
+        /* LOCKOUT */ LOCK_IGNORE,
+        /* BKSPACE */ LOCK_IGNORE,
+        /* SUBMIT  */ LOCK_IGNORE,
+        /* RELOCK  */ LOCK_IGNORE,
+    },
+    /* LOCK_LOCKOUT */ {
+        /* DIGIT   */ LOCK_IGNORE,
+        /* A       */ LOCK_IGNORE,
+        /* C       */ LOCK_IGNORE,
+        /* TIMEOUT */ { 0, 0, LOCK_LOCKED },            // backoff over
+        /* PIN_OK  */ LOCK_IGNORE,
+        /* PIN_BAD */ LOCK_IGNORE,
+        /* LOCKOUT */ LOCK_IGNORE,
+        /* BKSPACE */ LOCK_IGNORE,
+        /* SUBMIT  */ LOCK_IGNORE,
+        /* RELOCK  */ LOCK_IGNORE,
+    },
+};
+
+/* ====================================================================
+ * Engine
+ * ==================================================================== */
+static void lock_timeout(void) {
+    lock_timeoutDue = 1;                                // timer callback, interrupt context
+} // end lock_timeout
+
+// (Re)start the current state's inactivity timeout, if it has one. A
+// timeout that fired but was not serviced yet has freed its slot, which
+// may belong to someone else by now: only a pending one is stopped.
+static void lock_armTimeout(void) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    if (!lock_timeoutDue) {
+        timer_stop(lock_timer);
+    }
+    lock_timer = TIMER_NONE;
+    lock_timeoutDue = 0;
+    __set_interrupt_state(state);
+    if (lock_states[lock_state].timeoutMs == LOCK_BACKOFF) {
+        lock_timer = timer_start(lock_backoffMs(), 0, lock_timeout);
+    } else if (lock_states[lock_state].timeoutMs) {
+        lock_timer = timer_start(lock_states[lock_state].timeoutMs, 0, lock_timeout);
+    }
+} // end lock_armTimeout
+
+static void lock_enter(uint8_t state) {
+    uint8_t locked = (state != LOCK_UNLOCKED) && (state != LOCK_SET_PIN);
+
+    settings_write(SETTINGS_ID_LOCK, &locked, 1);       // no flash write unless it changed
+    lock_state = state;
+    lock_armTimeout();
+    if (lock_states[state].entry) {
+        lock_states[state].entry();
+    }
+} // end lock_enter
+
+// Requires timer_init(), creds_init() and settings_init(). A part that
+// was never locked starts unlocked.
+void lock_init(void) {
+    uint8_t locked = 0;
+
+    settings_read(SETTINGS_ID_LOCK, &locked, 1);
+    settings_read(SETTINGS_ID_FAILURES, &lock_failures, sizeof(lock_failures));
+    settings_read(SETTINGS_ID_USER, &lock_user, sizeof(lock_user));
+    if (!locked) {
+        lock_enter(LOCK_UNLOCKED);
+    } else {
+        lock_enter((lock_failures >= LOCK_FREE_ATTEMPTS) ? LOCK_LOCKOUT : LOCK_LOCKED);
+    }
+} // end lock_init
+
+// Transition action, exit action, entry action. The transition action
+// runs first so it still sees the state's data (the typed PIN) before the
+// exit action wipes it. An event raised by an action (the PIN check) is
+// dispatched right after, without recursion.
+void lock_dispatch(uint8_t event) {
+    while (event < LOCK_EVENTS) {
+        const lock_transition_t *t = &lock_table[lock_state][event];
+
+        lock_raised = LOCK_EV_NONE;
+        if ((t->next == LOCK_STAY) && !t->action) {
+            return;                                     // ignored, does not count as activity
+        }
+        if (t->guard && !t->guard()) {
+            return;
+        }
+
+        if (t->next != LOCK_STAY) {
+            if (t->action) {
+                t->action();
+            }
+            if (lock_states[lock_state].exit) {
+                lock_states[lock_state].exit();
+            }
+            lock_enter(t->next);
+        } else {
+            t->action();
+            lock_armTimeout();                          // activity restarts the timeout
+        }
+
+        event = lock_raised;
+    }
+} // end lock_dispatch
+
+void lock_key(char key) {
+    uint8_t event = LOCK_EV_NONE;
+
+    if ((key >= '0') && (key <= '9')) {
+        event = LOCK_EV_DIGIT;
+    } else if (key == 'A') {
+        event = LOCK_EV_A;
+    } else if (key == 'C') {
+        event = LOCK_EV_C;
+    } else if (key == '*') {
+        event = LOCK_EV_BACKSPACE;
+    } else if (key == '#') {
+        event = LOCK_EV_SUBMIT;
+    }
+
+    lock_lastKey = key;
+    lock_dispatch(event);
+} // end lock_key
+
+void lock_service(void) {
+    if (lock_timeoutDue) {
+        lock_timeoutDue = 0;
+        lock_timer = TIMER_NONE;                        // one-shot, already stopped
+        lock_dispatch(LOCK_EV_TIMEOUT);
+    }
+    if (lock_countdownDue) {
+        lock_countdownDue = 0;
+        if (lock_state == LOCK_LOCKOUT) {
+            lock_showCountdown();
+        }
+    }
+} // end lock_service
+
+uint8_t lock_getState(void) {
+    return lock_state;
+} // end lock_getState
+
+uint16_t lock_getFailures(void) {
+    return lock_failures;
+} // end lock_getFailures
+
+uint8_t lock_getPinLength(void) {
+    return lock_index;
+} // end lock_getPinLength
@@ -0,0 +1,103 @@
+/*
+ * lock.h
+ *
+ *  Table-driven lock state machine.
+ *
+ *  Behaviour is a const state x event table in flash: each cell holds an
+ *  optional guard, an optional transition action and the next state.
+ *  LOCK_STAY makes a cell an internal transition (action only), naming
+ *  the current state re-enters it. States have entry and exit actions and
+ *  an optional inactivity timeout that raises LOCK_EV_TIMEOUT. Dispatch is
+ *  one table lookup per event.
+ *
+ *  Locking and unlocking are saved in the settings store, so a reset or a
+ *  brown-out resumes locked rather than unlocked.
+ *
+ *  The door relocks on its own after the actuator's dwell; the application
+ *  reports that as LOCK_EV_RELOCKED and the lock follows it from UNLOCKED
+ *  to LOCKED. LOCK_RELOCK_MS without a key is the fallback for an
+ *  actuator that is not fitted or holds the door until told.
+ *
+ *  Wrong PINs are counted in the settings store too. From the
+ *  LOCK_FREE_ATTEMPTS-th one on, each failure starts a lockout that
+ *  doubles from LOCK_BACKOFF_MS up to LOCK_BACKOFF_MAX_MS. The lockout is
+ *  a state with a timer, the display counts down once a second and the
+ *  CPU sleeps in between; only the seconds are redrawn. A reset during a
+ *  lockout restarts it in full, since the time already waited is unknown.
+ *
+ *  PINs are 4 to 8 digits, entered masked: '*' deletes the last digit, '#'
+ *  submits. The digits never go to the display, only their count does
+ *  through lock_showPinMask().
+ *
+ *  The state machine only talks to the hardware through the hooks at the
+ *  bottom, which main.c implements, so the table can be driven on a host
+ *  with stub hooks: tools/host/lock_check.c replays every key and timer
+ *  sequence up to 7 events long against its invariants.
+ */
+
+#ifndef LOCK_H_
+#define LOCK_H_
+
+#include <stdint.h>
+
+#define LOCK_PIN_MIN        4                           // as CREDS_PIN_MIN
+#define LOCK_PIN_MAX        8                           // as CREDS_PIN_MAX
+#define LOCK_RELOCK_MS      30000UL                     // unlocked without activity -> locked
+#define LOCK_ENTRY_MS       15000UL                     // PIN entry without activity -> abandoned
+#define LOCK_FREE_ATTEMPTS  3                           // wrong PINs before lockouts start
+#define LOCK_BACKOFF_MS     30000UL                     // first lockout, doubles with every further failure
+#define LOCK_BACKOFF_MAX_MS 900000UL                    // timer_start() takes < 2^20 ms
+#define LOCK_COUNTDOWN_MS   1000
+
+/* ====================================================================
+ * States and Events
+ * ==================================================================== */
+#define LOCK_UNLOCKED       0
+#define LOCK_SET_PIN        1
+#define LOCK_LOCKED         2
+#define LOCK_ENTER_PIN      3
+#define LOCK_WRONG_PIN      4                           // locked, showing the failed attempt
+#define LOCK_LOCKOUT        5                           // locked, no PIN entry until the backoff ends
+#define LOCK_STATES         6
+#define LOCK_STAY           0xFF                        // next state of an internal transition
+
+#define LOCK_EV_DIGIT       0
+#define LOCK_EV_A           1
+#define LOCK_EV_C           2
+#define LOCK_EV_TIMEOUT     3                           // state inactivity timeout
+#define LOCK_EV_PIN_OK      4                           // raised by the PIN check
+#define LOCK_EV_PIN_BAD     5
+#define LOCK_EV_LOCKOUT     6                           // raised by the PIN check, backoff due
+#define LOCK_EV_BACKSPACE   7                           // *
+#define LOCK_EV_SUBMIT      8                           // #
+#define LOCK_EV_RELOCKED    9                           // the actuator relocked the door by itself
+#define LOCK_EVENTS         10
+#define LOCK_EV_NONE        0xFF
+
+/* ====================================================================
+ * Lock Prototype Definitions
+ * ==================================================================== */
+void lock_init(void);                                   // resume locked or unlocked, requires settings_init()
+void lock_service(void);                                // main loop, dispatches timeouts
+void lock_dispatch(uint8_t);
+void lock_key(char);                                    // map a key press to its event and dispatch
+uint8_t lock_getState(void);
+uint16_t lock_getFailures(void);                        // wrong PINs since the last right one
+uint8_t lock_getPinLength(void);                        // digits entered so far
+
+/* ====================================================================
+ * Hooks, implemented by the application
+ * ==================================================================== */
+void lock_showMessage(const char *);
+void lock_showPinMask(uint8_t);                         // digits entered, one more or one less than last time
+void lock_showSeconds(uint16_t);                        // lockout countdown, below the message, drawn on its own
+void setLockedLEDOn(void);
+void setLockedLEDOff(void);
+void setUnlockedLEDOn(void);
+void setUnlockedLEDOff(void);
+void flashLockedLED(void);
+void lock_alarmDisplay(void);                           // visual cue for a wrong PIN
+void lock_actuateUnlock(void);                          // right PIN: release the door, relocks by itself
+void lock_actuateLock(void);                            // locked: make sure the door is
+
+#endif /* LOCK_H_ */
@@ -39,203 +39,280 @@
 #include "ssd1306.h"
 #include "i2c.h"
 #include "clock.h"
+#include "ssd1306_image.h"
+#include "images.h"
+#include "ssd1306_fx.h"
+#include "ssd1306_burnin.h"
+#include "timer.h"
+#include "power.h"
+#include "keypad.h"
+#include "gesture.h"
+#include "latency.h"
+#include "ssd1306_console.h"
+#include "lock.h"
+#include "creds.h"
+#include "settings.h"
+#include "audit.h"
+#include "led.h"
+#include "actuator.h"
 
-#define MAX_PASSWORD_LENGTH 4
+#define LED_FLASH_CYCLES    10                  // wrong PIN: 10 on/off cycles of the locked LED
+#define SPLASH_MS           1000                // boot splash shown until a key is pressed or this elapses
+#define PIN_MASK_ROW        6                   // text row of the masked PIN, below the prompt
+#define PIN_MASK_X          ((SSD1306_LCDWIDTH - LOCK_PIN_MAX * 6) / 2)
 
-char storedPassword[MAX_PASSWORD_LENGTH + 1] = "0000"; // Default password, stores setted PIN
-char enteredPassword[MAX_PASSWORD_LENGTH + 1] = {0}; // Stores PIN entries
-unsigned char index = 0; // Tracks position in PIN arrays
-int mode = 0; // 0 = Door Open, 1 = Set Password, 2 = Locked, 3 = Enter Password
+unsigned char showingSplash = 0; // Boot splash still on screen
+volatile unsigned char splashExpired = 0; // Set by the splash timer
+uint32_t bootFirstPixelUs = 0; // Reset to boot splash on screen, shown on console B5
+uint32_t bootFirstKeyUs = 0; // Reset to first accepted keypress, shown on console B5
+unsigned char showingConsole = 0; // Diagnostics console on screen instead of the last message
+unsigned char consoleArmed = 0; // B pressed while unlocked: the next key may pick a console
+char shownMessage[40] = {0}; // Last message, redrawn when the console is closed
+uint8_t pinMaskShown = 0; // Mask glyphs on screen; the next one goes at PIN_MASK_X + 6 * pinMaskShown
+uint16_t secondsShown = 0; // Lockout seconds left, redrawn with the message when the console is closed
 
-void setupGPIO();
-char getKeypadInput();
 void displayMessage(const char* msg);
+void redrawScreen(void);
+uint8_t showConsole(char key);
 
-void setLockedLEDOn(void);
-void setLockedLEDOff(void);
-void flashLockedLED(void);
-void setUnlockedLEDOn(void);
-void setUnlockedLEDOff(void);
+void endSplash(void);
 
 int main(void) {
     WDTCTL = WDTPW + WDTHOLD; // Stop watchdog timer
 
-    // initialization functions from display library
+    timer_init(); // timebase for delays and display effects, also times the boot
+    power_init(); // account time per power state and subsystem from here on
+
+    // Staged boot: the DCO settles towards 25MHz in the background while
+    // everything below already runs on the divided-down clock.
     clock_init(); 
+    led_init(); // indicator LEDs on P1.4 and P1.5, PWM and patterns without the CPU
+    actuator_init(); // door strike or servo, released / locked until a right PIN
+    keypad_init(); // keypad lines interrupt on change, debounced by a timer
+
+    // initialization functions from display library
     i2c_init();
     ssd1306_init();
+    ssd1306_drawImage(0, 0, img_splash); // boot splash, decoded straight into GDDRAM
+    bootFirstPixelUs = TIMER_ACLK_TO_US(timer_getAclk());
+    showingSplash = 1;
+    timer_start(SPLASH_MS, 0, endSplash);
 
-    setupGPIO(); // initialization of indicator LED and keypad pins
-
-    // Start in unlocked state (mode 0)
-    mode = 0;
-    displayMessage("Unlocked. Press A to set PIN");
-    setLockedLEDOff();   // Locked LED off
-    setUnlockedLEDOn();  // Unlocked LED on
+    creds_init(); // user PINs in flash above 64KB, formatted on first boot
+    settings_init(); // settings log in INFO flash, survives resets and brown-outs
+    audit_init(); // audit log in flash, records this boot and its reset cause
+    lock_init(); // resume locked or unlocked; the prompt is drawn when the splash ends
+    burnin_enable(BURNIN_DEFAULT_INTERVAL_S); // slowly nudge the image to spread OLED wear
+    clock_setPerformance(CLOCK_PERF_LOW); // idle at low frequency and Vcore, burst on demand
+#if KEYPAD_HAS_RELEASE
+    gesture_setRepeat('*', 1); // * is backspace, held it keeps deleting; needs to see the release
+#endif
 
     while (1) {
-        char key = getKeypadInput(); // checks if a key has been pressed
-        if (key) { // proceeds only if valid keypress is received
+        clock_service(); // finish the staged boot once the DCO has settled
+        if (showingSplash && splashExpired) {
+            redrawScreen();
+        }
+        lock_service(); // relock and PIN entry timeouts
+        if (actuator_takeRelock()) {
+            lock_dispatch(LOCK_EV_RELOCKED); // the door relocked after its dwell, the display follows
+        }
+
+        uint8_t sub = power_begin(POWER_SUB_DISPLAY);
+        fx_service();       // advance running display effect, if a step is due
+        burnin_service();   // shift the image by a row, if a shift is due
+        power_end(sub);
 
-            // Unlocked state: allow setting a new PIN
-            if (mode == 0) {
-                if (key == 'A') {
-                    mode = 1; // Enter Set PIN mode
-                    index = 0; // reset index
-                    memset(enteredPassword, 0, sizeof(enteredPassword)); // reset enteredPassword
-                    displayMessage("Enter New PIN:");
-                    setLockedLEDOff(); // Locked LED off
-                    setUnlockedLEDOff(); // Unlocked LED off
+        gesture_service(); // turn queued key presses and releases into gestures
+        gesture_event_t g;
+        while (gesture_getEvent(&g)) { // drain every queued gesture, typed ahead or not
+            if (showingConsole) {
+                if (g.type == GESTURE_DOWN) { // any key closes the console
+                    showingConsole = 0;
+                    console_exit();
+                    redrawScreen();
                 }
+                continue;
             }
-            // Set PIN mode: enter 4-digit new PIN
-            else if (mode == 1) {
-                if (key >= '0' && key <= '9') {
-                    if (index < MAX_PASSWORD_LENGTH) {
-                        // When a number key is pressed, append it to enteredPassword
-                        enteredPassword[index++] = key;
-                        enteredPassword[index] = '\0';
-                        displayMessage(enteredPassword); // Update the display to show the current entered PIN
-                    }
-                }
-                else if (key == 'B') {
-                    // Save PIN only if 4 digits have been entered
-                    if (index == MAX_PASSWORD_LENGTH) {
-                        strcpy(storedPassword, enteredPassword); // copy new PIN to storedPassword
-                        mode = 2;  // Move to locked state
-                        displayMessage("Locked. Press C to enter PIN");
-                        setLockedLEDOn();   // In locked state, turn locked LED on
-                        setUnlockedLEDOff(); // Unlocked LED off
-                    }
-                }
+            if (g.type == GESTURE_CHORD) {
+                g.type = GESTURE_DOWN; // no chord bindings: the second key counts as a press of its own
+                g.key = g.key2;
             }
-            // Locked state: waiting for user to try unlocking
-            else if (mode == 2) {
-                if (key == 'C') {
-                    mode = 3; // Enter PIN entry mode
-                    index = 0; // reset index
-                    memset(enteredPassword, 0, sizeof(enteredPassword)); // reset enteredPassword
-                    displayMessage("Enter PIN, then press D");
-                    setLockedLEDOn();   // locked LED on
-                    setUnlockedLEDOff(); // unlocked LED off
-                }
+            if ((g.type == GESTURE_REPEAT) && (g.key == '*')) {
+                lock_key('*'); // hold * to keep deleting digits
+                continue;
             }
-            // Enter PIN mode: user types PIN then presses D to check
-            else if (mode == 3) {
-                if (key >= '0' && key <= '9') {
-                    if (index < MAX_PASSWORD_LENGTH) { 
-                        // When a number key is pressed, append it to enteredPassword
-                        enteredPassword[index++] = key;
-                        enteredPassword[index] = '\0';
-                        displayMessage(enteredPassword); // Update the display to show the current entered PIN
-                    }
-                }
-                else if (key == 'D') {
-                    if (index == MAX_PASSWORD_LENGTH) { 
-                        // Allow PIN verification only if 4 digits have been entered
-                        if (strcmp(storedPassword, enteredPassword) == 0) {
-                            // if entered PIN matches the stored PIN, system is unlocked
-                            mode = 0; // Unlocked
-                            displayMessage("Unlocked. Press A to set PIN");
-                            setLockedLEDOff();
-                            setUnlockedLEDOn();
-                            
-                        } else {
-                            // if entered PIN doesn't match the stored PIN, system remains locked
-                            displayMessage("Wrong PIN! Press C to try again");
-                            flashLockedLED();   // Flash locked LED 
-                            mode = 2;           // Remain locked
-                            setLockedLEDOn();
-                            setUnlockedLEDOff();
-                        }
-                    }
+            if (g.type != GESTURE_DOWN) {
+                continue; // digits and commands act on key down
+            }
+            if (consoleArmed) {
+                consoleArmed = 0;
+                if (showConsole(g.key)) {
+                    continue; // B then a digit: the digit picks a console instead of reaching the lock
                 }
             }
-        }
-    }
-}
 
-void setupGPIO() {
-    // Configure LED on P1.4 (locked LED) and P1.5 (unlocked LED) as outputs.
-    P1DIR |= (BIT4 | BIT5);
-    P1OUT &= ~(BIT4 | BIT5);  // Turn both off initially
+            char key = g.key;
+            latency_begin(g.aclk, g.decodeAclk); // trace this press until its redraw is on the bus
+            uint8_t keySub = power_begin(POWER_SUB_KEYPAD);
+            if (!bootFirstKeyUs) {
+                bootFirstKeyUs = TIMER_ACLK_TO_US(timer_getAclk());
+            }
 
-    // Configure keypad inputs from encoder on P2.3-P2.6 with pull-up resistors.
-    P2SEL &= ~(BIT3 | BIT4 | BIT5 | BIT6);
-    P2DIR &= ~(BIT3 | BIT4 | BIT5 | BIT6);
-    P2REN |= (BIT3 | BIT4 | BIT5 | BIT6);
-    P2OUT |= (BIT3 | BIT4 | BIT5 | BIT6);
-}
+            if (showingSplash) {
+                redrawScreen(); // a key dismisses the splash
+            }
+            lock_key(key); // one transition table lookup per key
+            power_end(keySub);
+            consoleArmed = (key == 'B') && (lock_getState() == LOCK_UNLOCKED); // B has no lock action
+        }
 
-char getKeypadInput() {
-    static char lastKey = 0;
-    // Read from P2.3-P2.6; shift by 3 so BIT3 becomes BIT0.
-    unsigned char bcd = (P2IN & (BIT3 | BIT4 | BIT5 | BIT6)) >> 3;
-    char key = 0;
-    
-    // Map BCD value to the corresponding character.
-    switch (bcd) {
-        case 0b0000: key = '1'; break;
-        case 0b0001: key = '2'; break;
-        case 0b0010: key = '3'; break;
-        case 0b0011: key = 'A'; break;
-        case 0b0100: key = '4'; break;
-        case 0b0101: key = '5'; break;
-        case 0b0110: key = '6'; break;
-        case 0b0111: key = 'B'; break;
-        case 0b1000: key = '7'; break;
-        case 0b1001: key = '8'; break;
-        case 0b1010: key = '9'; break;
-        case 0b1011: key = 'C'; break;
-        case 0b1100: key = '*'; break;
-        case 0b1101: key = '0'; break;
-        case 0b1110: key = '#'; break;
-        case 0b1111: key = 'D'; break;
-        default: key = 0;
+        if (gesture_isIdle()) {
+            settings_service(); // erase retired settings segments while no key is being handled
+            audit_service(); // commit buffered audit records, erase the next log segment ahead
+        }
+        timer_idle(); // sleep until the next timer or interrupt needs the main loop
     }
+}
 
-    // Avoid processing the same key multiple times.
-    if (key == lastKey) {
+// Diagnostics consoles, opened with B and a digit while unlocked. Key
+// sequences rather than chords: with the BCD encoder every press is
+// released at once, so two keys are never down together. 0 if the key
+// picks no console.
+uint8_t showConsole(char key) {
+    if ((key < '1') || (key > '5')) {
         return 0;
     }
-    lastKey = key;
-    __delay_cycles(200000);  // debounce delay
-    return key;
+    showingConsole = 1;
+    console_init();
+    if (key == '1') {
+        latency_dump(console_println); // keypress-to-pixel latency per stage
+    } else if (key == '2') {
+        settings_dump(console_println); // flash writes, erases and PIN hash cost
+        creds_dumpHashCost(console_println);
+    } else if (key == '3') {
+        audit_dump(console_println); // newest audit records
+    } else if (key == '4') {
+        actuator_dump(console_println); // actuator energy per unlock
+    } else {
+        char line[24];
+        clock_dump(console_println); // clock source, measured MCLK, crystal start-up
+        snprintf(line, sizeof(line), "boot pixel%9luus", (unsigned long)bootFirstPixelUs);
+        console_println(line);
+        snprintf(line, sizeof(line), "boot key  %9luus", (unsigned long)bootFirstKeyUs);
+        console_println(line);
+    }
+    return 1;
+} // end showConsole
+
+// Full redraw of the last message and the PIN mask, after the splash or console.
+void redrawScreen(void) {
+    displayMessage(shownMessage);
+    if (lock_getPinLength()) {
+        lock_showPinMask(lock_getPinLength());
+    }
+    if (lock_getState() == LOCK_LOCKOUT) {
+        lock_showSeconds(secondsShown);
+    }
 }
 
 void displayMessage(const char* msg) {
     char buffer[100];  // Adjust buffer size as needed.
     // Workaround for the ssd1306_printTextBlock bug: append an extra space.
     snprintf(buffer, sizeof(buffer), "%s ", msg);
+    if (msg != shownMessage) {
+        strncpy(shownMessage, msg, sizeof(shownMessage) - 1);
+    }
+    showingSplash = 0;
 
+    latency_drawStart();
+    uint8_t sub = power_begin(POWER_SUB_DISPLAY);
+    clock_requestBurst(); // full redraw, run the bus at full speed
     ssd1306_clearDisplay();
+    pinMaskShown = 0;
     ssd1306_printTextBlock(0, 2, buffer);
-    __delay_cycles(100000);
+    latency_drawDone(); // printTextBlock returns after the last byte and stop condition
+    clock_releaseBurst();
+    power_end(sub);
+}
+
+// Lock state machine hooks
+void lock_showMessage(const char *msg) {
+    if (showingSplash || showingConsole) {
+        strncpy(shownMessage, msg, sizeof(shownMessage) - 1); // drawn when the splash or console goes
+        return;
+    }
+    displayMessage(msg);
+}
+void lock_showPinMask(uint8_t count) {
+    if (showingSplash || showingConsole) {
+        return; // drawn by redrawScreen() later
+    }
+
+    latency_drawStart();
+    uint8_t sub = power_begin(POWER_SUB_DISPLAY);
+    if (count == pinMaskShown + 1) {
+        ssd1306_printText(PIN_MASK_X + 6 * pinMaskShown, PIN_MASK_ROW, "*"); // one glyph at the cached position
+    } else if (count + 1 == pinMaskShown) {
+        ssd1306_printText(PIN_MASK_X + 6 * count, PIN_MASK_ROW, " "); // backspace: blank the last glyph
+    } else {
+        char mask[LOCK_PIN_MAX + 1];
+        uint8_t i;
+        for (i = 0; i < LOCK_PIN_MAX; i++) {
+            mask[i] = (i < count) ? '*' : ' ';
+        }
+        mask[LOCK_PIN_MAX] = '\0';
+        ssd1306_printText(PIN_MASK_X, PIN_MASK_ROW, mask);
+    }
+    pinMaskShown = count;
+    latency_drawDone();
+    power_end(sub);
+}
+void lock_showSeconds(uint16_t seconds) {
+    char field[7];
+
+    secondsShown = seconds;
+    if (showingSplash || showingConsole) {
+        return; // drawn by redrawScreen() later
+    }
+
+    snprintf(field, sizeof(field), "%4us", (unsigned)seconds); // fixed width, overwrites the last count
+    uint8_t sub = power_begin(POWER_SUB_DISPLAY);
+    ssd1306_printText(PIN_MASK_X, PIN_MASK_ROW, field); // one text row, the message stays
+    power_end(sub);
+}
+void lock_actuateUnlock(void) {
+    actuator_unlock();
+}
+void lock_actuateLock(void) {
+    actuator_lock();
+}
+void lock_alarmDisplay(void) {
+    fx_invertFlash(3, 300); // Flash the display, a few command bytes per step
 }
 
 // Functions for locked LED (P1.4)
 void setLockedLEDOn(void) {
-    P1OUT |= BIT4;
+    led_set(LED_LOCKED, LED_LEVEL_MAX); // also cancels flashing
 }
 void setLockedLEDOff(void) {
-    P1OUT &= ~BIT4;
+    led_set(LED_LOCKED, 0);
 }
 void flashLockedLED(void) {
-    int i;
-    for (i = 0; i < 10; i++) {
-        P1OUT ^= BIT4;       // Toggle locked LED on P1.4
-        __delay_cycles(3000000);
-        P1OUT ^= BIT4;
-        __delay_cycles(3000000);
-    }
+    // Played by Timer_A1 and DMA, then back to the level last set
+    led_play(LED_LOCKED, LED_PATTERN_FLASH, LED_FLASH_CYCLES);
+}
+
+void endSplash(void) { // timer callback, interrupt context
+    splashExpired = 1;
 }
 
 // Functions for unlocked LED (P1.5)
 void setUnlockedLEDOn(void) {
-    P1OUT |= BIT5;
+    led_set(LED_UNLOCKED, LED_LEVEL_MAX);
 }
 void setUnlockedLEDOff(void) {
-    P1OUT &= ~BIT5;
+    led_set(LED_UNLOCKED, 0);
 }
 // Below is code from display library for interrupt
 //------------------------------------------------------------------------------
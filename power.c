@@ -0,0 +1,134 @@
+/*
+ * power.c
+ *
+ *  Time per power state and subsystem, and charge estimates from it.
+ */
+
+#include "power.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "timer.h"
+#include "clock.h"
+
+#if POWER_ACCOUNTING
+
+static uint64_t power_ticks[POWER_SUBSYSTEMS][POWER_STATES];   // ACLK cycles
+static uint32_t power_since;                            // ACLK count the open interval started at
+static uint8_t power_sub = POWER_SUB_IDLE;
+static uint8_t power_state = POWER_ACTIVE_LOW;
+
+static const uint16_t power_ua[POWER_STATES] = {
+    POWER_UA_ACTIVE_LOW,
+    POWER_UA_ACTIVE_BURST,
+    POWER_UA_LPM0,
+    POWER_UA_LPM3
+};
+
+static uint8_t power_activeState(void) {
+    return (clock_getPerformance() == CLOCK_PERF_BURST) ? POWER_ACTIVE_BURST : POWER_ACTIVE_LOW;
+} // end power_activeState
+
+// Close the open interval and start the next one in state; interrupts disabled.
+static void power_switch(uint8_t state) {
+    uint32_t now = timer_getAclk();
+    power_ticks[power_sub][power_state] += now - power_since;
+    power_since = now;
+    power_state = state;
+} // end power_switch
+
+// Requires timer_init().
+void power_init(void) {
+    power_reset();
+} // end power_init
+
+// Attribute the following time to a subsystem:
+//     uint8_t prev = power_begin(POWER_SUB_DISPLAY); ... power_end(prev);
+uint8_t power_begin(uint8_t sub) {
+    uint16_t state = __get_interrupt_state();
+    uint8_t prev;
+
+    __disable_interrupt();
+    prev = power_sub;
+    power_switch(power_state);
+    power_sub = sub;
+    __set_interrupt_state(state);
+
+    return prev;
+} // end power_begin
+
+void power_end(uint8_t prev) {
+    power_begin(prev);
+} // end power_end
+
+void power_sleepBegin(uint8_t state) {
+    power_switch(state);
+} // end power_sleepBegin
+
+void power_sleepEnd(void) {
+    power_switch(power_activeState());
+} // end power_sleepEnd
+
+void power_mark(void) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    power_switch(power_activeState());
+    __set_interrupt_state(state);
+} // end power_mark
+
+// Time spent in a state, including the interval still open. Wraps after ~49 days.
+uint32_t power_getMs(uint8_t sub, uint8_t state) {
+    uint16_t gie = __get_interrupt_state();
+    uint64_t ticks;
+
+    __disable_interrupt();
+    power_switch(power_state);
+    ticks = power_ticks[sub][state];
+    __set_interrupt_state(gie);
+
+    return (uint32_t)((ticks * 1000) / TIMER_ACLK_HZ);
+} // end power_getMs
+
+// Estimated charge drawn while sub was current, in microcoulombs (uA x s);
+// divide by 3600 for uAh.
+uint32_t power_getChargeUc(uint8_t sub) {
+    uint16_t gie = __get_interrupt_state();
+    uint64_t uaTicks = 0;
+    uint8_t s;
+
+    __disable_interrupt();
+    power_switch(power_state);
+    for (s = 0; s < POWER_STATES; s++) {
+        uaTicks += power_ticks[sub][s] * power_ua[s];
+    }
+    __set_interrupt_state(gie);
+
+    return (uint32_t)(uaTicks / TIMER_ACLK_HZ);
+} // end power_getChargeUc
+
+uint32_t power_getTotalChargeUc(void) {
+    uint32_t total = 0;
+    uint8_t sub;
+
+    for (sub = 0; sub < POWER_SUBSYSTEMS; sub++) {
+        total += power_getChargeUc(sub);
+    }
+
+    return total;
+} // end power_getTotalChargeUc
+
+void power_reset(void) {
+    uint16_t state = __get_interrupt_state();
+    uint8_t sub, s;
+
+    __disable_interrupt();
+    for (sub = 0; sub < POWER_SUBSYSTEMS; sub++) {
+        for (s = 0; s < POWER_STATES; s++) {
+            power_ticks[sub][s] = 0;
+        }
+    }
+    power_since = timer_getAclk();
+    __set_interrupt_state(state);
+} // end power_reset
+
+#endif /* POWER_ACCOUNTING */
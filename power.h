@@ -0,0 +1,84 @@
+/*
+ * power.h
+ *
+ *  Energy accounting per power state and subsystem.
+ *
+ *  Every LPM entry and exit is timestamped with the ACLK timebase and the
+ *  time since the previous timestamp is added to the current subsystem and
+ *  power state. Active time is split by performance level since the current
+ *  differs by an order of magnitude. Interrupt handlers are counted towards
+ *  the state they interrupted.
+ *
+ *  Charge estimates use the POWER_UA_* figures below: typical MCU-only
+ *  datasheet values at 3V, override them with measured ones. The OLED is
+ *  not included.
+ */
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+
+#ifndef POWER_ACCOUNTING
+#define POWER_ACCOUNTING    1                           // 0 compiles the hooks out
+#endif
+
+/* ====================================================================
+ * Subsystems and States
+ * ==================================================================== */
+#define POWER_SUB_IDLE      0                           // nothing else claimed the CPU
+#define POWER_SUB_DISPLAY   1
+#define POWER_SUB_KEYPAD    2
+#define POWER_SUB_CRYPTO    3
+#define POWER_SUBSYSTEMS    4
+
+#define POWER_ACTIVE_LOW    0                           // CPU on, CLOCK_PERF_LOW
+#define POWER_ACTIVE_BURST  1                           // CPU on, CLOCK_PERF_BURST
+#define POWER_LPM0          2
+#define POWER_LPM3          3
+#define POWER_STATES        4
+
+/* ====================================================================
+ * Current Figures, microamps
+ * ==================================================================== */
+#ifndef POWER_UA_ACTIVE_LOW
+#define POWER_UA_ACTIVE_LOW     450                     // ~1.5MHz, Vcore 0
+#endif
+#ifndef POWER_UA_ACTIVE_BURST
+#define POWER_UA_ACTIVE_BURST   9000                    // 25MHz, Vcore 3
+#endif
+#ifndef POWER_UA_LPM0
+#define POWER_UA_LPM0           90                      // DCO and FLL kept running
+#endif
+#ifndef POWER_UA_LPM3
+#define POWER_UA_LPM3           3                       // REFO and Timer_B0 only
+#endif
+
+/* ====================================================================
+ * Power Prototype Definitions
+ * ==================================================================== */
+#if POWER_ACCOUNTING
+void power_init(void);
+uint8_t power_begin(uint8_t);                           // returns the previous subsystem
+void power_end(uint8_t);                                // restore it
+void power_sleepBegin(uint8_t);                         // interrupts disabled, right before LPM entry
+void power_sleepEnd(void);                              // interrupts disabled, right after wake-up
+void power_mark(void);                                  // performance level changed
+uint32_t power_getMs(uint8_t, uint8_t);                 // subsystem, state
+uint32_t power_getChargeUc(uint8_t);                    // subsystem, microcoulombs (uAs)
+uint32_t power_getTotalChargeUc(void);
+void power_reset(void);
+#else                                                   // stubs use their arguments, no unused-variable warnings
+#define power_init()                ((void)0)
+#define power_begin(sub)            ((void)(sub), (uint8_t)0)
+#define power_end(prev)             ((void)(prev))
+#define power_sleepBegin(state)     ((void)(state))
+#define power_sleepEnd()            ((void)0)
+#define power_mark()                ((void)0)
+#define power_getMs(sub, state)     ((void)(sub), (void)(state), 0UL)
+#define power_getChargeUc(sub)      ((void)(sub), 0UL)
+#define power_getTotalChargeUc()    0UL
+#define power_reset()               ((void)0)
+#endif
+
+#endif /* POWER_H_ */
@@ -0,0 +1,333 @@
+/*
+ * settings.c
+ *
+ *  Append-only settings log in information flash with wear leveling.
+ */
+
+#include "settings.h"
+#include <msp430.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+
+#define SETTINGS_MAGIC      0x5354                      // "ST"
+#define SETTINGS_HEADER     6                           // magic, sequence low, sequence high
+#define SETTINGS_INFOA      3                           // segment behind LOCKA
+
+#define SETTINGS_READ16(addr)   (*(const volatile uint16_t *)(addr))
+
+static uint8_t settings_active;                         // segment in use
+static uint8_t settings_top;                            // append offset in it
+static uint8_t settings_latest[SETTINGS_IDS];           // offset of the newest valid record, 0 = none
+static uint8_t settings_retired;                        // segments waiting for an erase, bit per segment
+static uint32_t settings_seq;                           // generation of the active segment
+static settings_stats_t settings_stats;
+
+static uint16_t settings_addr(uint8_t segment) {
+    return SETTINGS_BASE + (uint16_t)segment * SETTINGS_SEGMENT;
+} // end settings_addr
+
+static uint8_t settings_recordSize(uint8_t len) {
+    return 4 + ((len + 1) & ~1);                        // header, data padded to a word, CRC
+} // end settings_recordSize
+
+/* ====================================================================
+ * Flash Access
+ * ==================================================================== */
+// INFOA has its own lock bit, which toggles when written with 1.
+static void settings_unlock(uint8_t segment) {
+    FCTL3 = FWKEY;                              // Clear Lock bit
+    if ((segment == SETTINGS_INFOA) && (FCTL3 & LOCKA)) {
+        FCTL3 = FWKEY + LOCKA;                  // Clear LOCKA bit
+    }
+} // end settings_unlock
+
+static void settings_lock(uint8_t segment) {
+    if ((segment == SETTINGS_INFOA) && !(FCTL3 & LOCKA)) {
+        FCTL3 = FWKEY + LOCK + LOCKA;           // Set Lock and LOCKA bits
+    } else {
+        FCTL3 = FWKEY + LOCK;                   // Set Lock bit
+    }
+} // end settings_lock
+
+static void settings_write16(uint8_t segment, uint16_t addr, uint16_t value) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    settings_unlock(segment);
+    FCTL1 = FWKEY + WRT;                        // Enable word write
+    *(volatile uint16_t *)addr = value;
+    while (FCTL3 & BUSY);
+    FCTL1 = FWKEY;                              // Clear WRT bit
+    settings_lock(segment);
+    __set_interrupt_state(state);
+} // end settings_write16
+
+static void settings_erase(uint8_t segment) {
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    settings_unlock(segment);
+    FCTL1 = FWKEY + ERASE;                      // Set Erase bit
+    *(volatile uint16_t *)settings_addr(segment) = 0;  // Dummy write to erase Flash seg
+    while (FCTL3 & BUSY);
+    settings_lock(segment);
+    __set_interrupt_state(state);
+
+    settings_retired &= ~(1 << segment);
+    settings_stats.erases[segment]++;
+} // end settings_erase
+
+static uint8_t settings_isErased(uint16_t addr, uint8_t bytes) {
+    for (; bytes > 0; bytes -= 2, addr += 2) {
+        if (SETTINGS_READ16(addr) != 0xFFFF) {
+            return 0;
+        }
+    }
+    return 1;
+} // end settings_isErased
+
+/* ====================================================================
+ * Records
+ * ==================================================================== */
+// CRC-CCITT on the CRC16 module over the header word and the data, odd
+// data padded with 0xFF. Never 0xFFFF, so an unwritten CRC word can not
+// pass for a valid one.
+static uint16_t settings_crc(uint16_t header, const uint8_t *data, uint8_t len) {
+    uint8_t i;
+
+    CRCINIRES = 0xFFFF;
+    CRCDI = header;
+    for (i = 0; i < len; i += 2) {
+        CRCDI = data[i] | ((uint16_t)((i + 1 < len) ? data[i + 1] : 0xFF) << 8);
+    }
+    return (CRCINIRES == 0xFFFF) ? 0xFFFE : CRCINIRES;
+} // end settings_crc
+
+// Header first and CRC last: a record cut short by a reset fails its CRC.
+static void settings_program(uint8_t segment, uint8_t offset, uint8_t id, const uint8_t *data, uint8_t len) {
+    uint16_t addr = settings_addr(segment) + offset;
+    uint16_t header = ((uint16_t)id << 8) | len;
+    uint8_t i;
+
+    settings_write16(segment, addr, header);
+    addr += 2;
+    for (i = 0; i < len; i += 2, addr += 2) {
+        settings_write16(segment, addr, data[i] | ((uint16_t)((i + 1 < len) ? data[i + 1] : 0xFF) << 8));
+    }
+    settings_write16(segment, addr, settings_crc(header, data, len));
+} // end settings_program
+
+// Index the valid records of the active segment and find the append point.
+static void settings_scan(void) {
+    uint16_t base = settings_addr(settings_active);
+    uint8_t offset = SETTINGS_HEADER;
+    uint8_t id;
+
+    for (id = 0; id < SETTINGS_IDS; id++) {
+        settings_latest[id] = 0;
+    }
+
+    while (offset + 4 <= SETTINGS_SEGMENT) {
+        uint16_t header = SETTINGS_READ16(base + offset);
+        uint8_t len = header & 0xFF;
+        uint8_t size = settings_recordSize(len);
+
+        if (header == 0xFFFF) {
+            break;                                      // end of the log
+        }
+        id = header >> 8;
+        if ((id >= SETTINGS_IDS) || (len == 0) || (len > SETTINGS_MAX_LEN) || (offset + size > SETTINGS_SEGMENT)) {
+            offset = SETTINGS_SEGMENT;                  // garbled: append nothing more here
+            break;
+        }
+
+        const uint8_t *data = (const uint8_t *)(base + offset + 2);
+        if (SETTINGS_READ16(base + offset + size - 2) == settings_crc(header, data, len)) {
+            settings_latest[id] = offset;
+        }
+        offset += size;
+    }
+
+    settings_top = offset;
+} // end settings_scan
+
+// Copy the newest version of every other id and the new record into the
+// next segment, then validate it with its header. Returns SETTINGS_OK or
+// SETTINGS_ERR_FULL, in which case nothing was written.
+static uint8_t settings_compact(uint8_t id, const uint8_t *data, uint8_t len) {
+    uint8_t next = (settings_active + 1) % SETTINGS_SEGMENTS;
+    uint16_t from = settings_addr(settings_active);
+    uint16_t to = settings_addr(next);
+    uint16_t need = SETTINGS_HEADER + settings_recordSize(len);
+    uint8_t offset = SETTINGS_HEADER;
+    uint8_t i;
+
+    for (i = 0; i < SETTINGS_IDS; i++) {
+        if (settings_latest[i] && (i != id)) {
+            need += settings_recordSize(SETTINGS_READ16(from + settings_latest[i]) & 0xFF);
+        }
+    }
+    if (need > SETTINGS_SEGMENT) {
+        return SETTINGS_ERR_FULL;
+    }
+
+    if ((settings_retired & (1 << next)) || !settings_isErased(to, SETTINGS_SEGMENT)) {
+        settings_erase(next);                           // settings_service() did not get to it
+        settings_stats.forcedErases++;
+    }
+
+    for (i = 0; i < SETTINGS_IDS; i++) {
+        if (settings_latest[i] && (i != id)) {
+            uint16_t src = from + settings_latest[i];
+            uint8_t size = settings_recordSize(SETTINGS_READ16(src) & 0xFF);
+            uint8_t w;
+            for (w = 0; w < size; w += 2) {
+                settings_write16(next, to + offset + w, SETTINGS_READ16(src + w));
+            }
+            offset += size;
+        }
+    }
+    settings_program(next, offset, id, data, len);
+
+    settings_seq++;
+    settings_write16(next, to + 2, (uint16_t)settings_seq);
+    settings_write16(next, to + 4, (uint16_t)(settings_seq >> 16));
+    settings_write16(next, to, SETTINGS_MAGIC);         // the switch-over
+
+    settings_retired |= 1 << settings_active;
+    settings_active = next;
+    settings_stats.generation = settings_seq;
+    settings_scan();
+    return SETTINGS_OK;
+} // end settings_compact
+
+/* ====================================================================
+ * Settings Functions
+ * ==================================================================== */
+void settings_init(void) {
+    uint8_t found = 0;
+    uint8_t segment;
+
+    for (segment = 0; segment < SETTINGS_SEGMENTS; segment++) {
+        uint16_t base = settings_addr(segment);
+        if (SETTINGS_READ16(base) == SETTINGS_MAGIC) {
+            uint32_t seq = SETTINGS_READ16(base + 2) | ((uint32_t)SETTINGS_READ16(base + 4) << 16);
+            if (!found || ((int32_t)(seq - settings_seq) > 0)) {
+                if (found) {
+                    settings_retired |= 1 << settings_active;   // superseded, erase was cut short
+                }
+                settings_active = segment;
+                settings_seq = seq;
+                found = 1;
+                continue;
+            }
+        }
+        if (!settings_isErased(base, SETTINGS_SEGMENT)) {
+            settings_retired |= 1 << segment;           // old, or an interrupted compaction
+        }
+    }
+
+    if (!found) {
+        settings_active = 0;                            // blank part
+        settings_seq = 0;
+        if (settings_retired & 0x1) {
+            settings_erase(0);
+        }
+        settings_write16(0, settings_addr(0) + 2, 0);
+        settings_write16(0, settings_addr(0) + 4, 0);
+        settings_write16(0, settings_addr(0), SETTINGS_MAGIC);
+    }
+
+    settings_stats.generation = settings_seq;
+    settings_scan();
+} // end settings_init
+
+uint8_t settings_read(uint8_t id, void *buffer, uint8_t size) {
+    if ((id >= SETTINGS_IDS) || !settings_latest[id]) {
+        return 0;
+    }
+
+    uint16_t addr = settings_addr(settings_active) + settings_latest[id];
+    const uint8_t *data = (const uint8_t *)(addr + 2);
+    uint8_t len = SETTINGS_READ16(addr) & 0xFF;
+    uint8_t i;
+
+    if (len > size) {
+        len = size;
+    }
+    for (i = 0; i < len; i++) {
+        ((uint8_t *)buffer)[i] = data[i];
+    }
+    return len;
+} // end settings_read
+
+uint8_t settings_write(uint8_t id, const void *value, uint8_t len) {
+    const uint8_t *data = (const uint8_t *)value;
+    uint8_t result = SETTINGS_OK;
+    uint8_t i;
+
+    if ((id >= SETTINGS_IDS) || (len == 0) || (len > SETTINGS_MAX_LEN)) {
+        return SETTINGS_ERR_ARG;
+    }
+
+    if (settings_latest[id]) {                          // skip a write that changes nothing
+        uint16_t addr = settings_addr(settings_active) + settings_latest[id];
+        const uint8_t *old = (const uint8_t *)(addr + 2);
+        if ((SETTINGS_READ16(addr) & 0xFF) == len) {
+            for (i = 0; (i < len) && (old[i] == data[i]); i++);
+            if (i == len) {
+                return SETTINGS_OK;
+            }
+        }
+    }
+
+    uint32_t start = timer_getAclk();
+    uint8_t size = settings_recordSize(len);
+
+    if ((settings_top + size <= SETTINGS_SEGMENT) &&
+        settings_isErased(settings_addr(settings_active) + settings_top, size)) {
+        settings_program(settings_active, settings_top, id, data, len);
+        settings_latest[id] = settings_top;
+        settings_top += size;
+    } else {
+        result = settings_compact(id, data, len);
+    }
+
+    settings_stats.lastWriteUs = TIMER_ACLK_TO_US(timer_getAclk() - start);
+    if (settings_stats.lastWriteUs > settings_stats.maxWriteUs) {
+        settings_stats.maxWriteUs = settings_stats.lastWriteUs;
+    }
+    settings_stats.writes++;
+    return result;
+} // end settings_write
+
+void settings_service(void) {
+    uint8_t segment;
+
+    for (segment = 0; segment < SETTINGS_SEGMENTS; segment++) {
+        if (settings_retired & (1 << segment)) {
+            settings_erase(segment);                    // one per call, ~25ms
+            return;
+        }
+    }
+} // end settings_service
+
+void settings_getStats(settings_stats_t *stats) {
+    *stats = settings_stats;
+} // end settings_getStats
+
+// Generation and writes, write time in us, then erases since reset per
+// segment (D C B A) and how many had to be done inline.
+void settings_dump(settings_sink_t sink) {
+    char line[32];
+
+    snprintf(line, sizeof(line), "gen%6lu wr%6u", (unsigned long)settings_stats.generation, settings_stats.writes);
+    sink(line);
+    snprintf(line, sizeof(line), "us %6lu max%6lu", (unsigned long)settings_stats.lastWriteUs,
+             (unsigned long)settings_stats.maxWriteUs);
+    sink(line);
+    snprintf(line, sizeof(line), "er%3u%3u%3u%3u f%3u", settings_stats.erases[0], settings_stats.erases[1],
+             settings_stats.erases[2], settings_stats.erases[3], settings_stats.forcedErases);
+    sink(line);
+} // end settings_dump
@@ -0,0 +1,70 @@
+/*
+ * settings.h
+ *
+ *  Persistent settings in information flash, INFOD to INFOA.
+ *
+ *  The four 128-byte segments hold an append-only log of small records
+ *  (id, length, data, CRC). A write appends a new version of the record;
+ *  reads return the newest version with a valid CRC. When the active
+ *  segment is full, the newest version of every id is copied into the
+ *  next segment in turn, so erases are spread evenly over all four.
+ *
+ *  Power cuts: a record only counts once its CRC word, written last, is
+ *  valid, and a compacted segment only counts once its header, written
+ *  after the copies, is; until then the old segment stays in use. A torn
+ *  write is therefore either complete or ignored.
+ *
+ *  Word writes take well under a millisecond, a segment erase ~25ms with
+ *  the CPU held. Erases of retired segments are deferred to
+ *  settings_service(), which the main loop only calls when no key is
+ *  being handled. Only if a compaction finds its target still unerased is
+ *  the erase done inline (counted in settings_stats_t.forcedErases).
+ */
+
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <stdint.h>
+
+#define SETTINGS_BASE       0x1800                      // INFOD, must match lnk_msp430f5529.cmd
+#define SETTINGS_SEGMENT    128
+#define SETTINGS_SEGMENTS   4                           // INFOD, INFOC, INFOB, INFOA
+#define SETTINGS_MAX_LEN    16                          // data bytes per record
+#define SETTINGS_IDS        8                           // ids 0..7
+
+#define SETTINGS_ID_LOCK    1                           // uint8_t, 1 = locked
+#define SETTINGS_ID_PIN_LOG 2                           // settings_pinLog_t
+#define SETTINGS_ID_FAILURES 3                          // uint16_t, wrong PINs since the last right one
+#define SETTINGS_ID_USER    4                           // creds_user_t, who unlocked last
+
+#define SETTINGS_OK         0
+#define SETTINGS_ERR_ARG    1                           // bad id or length
+#define SETTINGS_ERR_FULL   2                           // live records do not fit a segment
+
+typedef struct {
+    uint16_t changes;                                   // PIN changes so far
+    uint16_t lastUser;                                  // user id of the latest one
+} settings_pinLog_t;
+
+typedef struct {
+    uint32_t generation;                                // compactions over the life of the part
+    uint16_t writes;                                    // since reset
+    uint32_t lastWriteUs;                               // ACLK resolution, 30.5us
+    uint32_t maxWriteUs;
+    uint16_t erases[SETTINGS_SEGMENTS];                 // since reset, INFOD first
+    uint16_t forcedErases;                              // erases that could not be deferred
+} settings_stats_t;
+
+typedef void (*settings_sink_t)(const char *);
+
+/* ====================================================================
+ * Settings Prototype Definitions
+ * ==================================================================== */
+void settings_init(void);                               // requires timer_init()
+uint8_t settings_read(uint8_t, void *, uint8_t);        // id, buffer, size; returns bytes read, 0 if never written
+uint8_t settings_write(uint8_t, const void *, uint8_t); // id, data, length; unchanged data is not rewritten
+void settings_service(void);                            // main loop while idle, erases one retired segment
+void settings_getStats(settings_stats_t *);
+void settings_dump(settings_sink_t);                    // a few lines, e.g. console_println
+
+#endif /* SETTINGS_H_ */
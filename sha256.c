@@ -0,0 +1,83 @@
+/*
+ * sha256.c
+ *
+ *  Single-block SHA-256 (FIPS 180-4).
+ */
+
+#include "sha256.h"
+#include <stdint.h>
+
+#define SHA256_ROTR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA256_S0(x)        (SHA256_ROTR(x, 2) ^ SHA256_ROTR(x, 13) ^ SHA256_ROTR(x, 22))
+#define SHA256_S1(x)        (SHA256_ROTR(x, 6) ^ SHA256_ROTR(x, 11) ^ SHA256_ROTR(x, 25))
+#define SHA256_G0(x)        (SHA256_ROTR(x, 7) ^ SHA256_ROTR(x, 18) ^ ((x) >> 3))
+#define SHA256_G1(x)        (SHA256_ROTR(x, 17) ^ SHA256_ROTR(x, 19) ^ ((x) >> 10))
+#define SHA256_CH(e, f, g)  ((g) ^ ((e) & ((f) ^ (g))))
+#define SHA256_MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
+
+// One round; the caller rotates the variable names instead of the values.
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i)                                 \
+    t = h + SHA256_S1(e) + SHA256_CH(e, f, g) + sha256_k[i] + w[(i) & 15];      \
+    d += t;                                                                     \
+    h = t + SHA256_S0(a) + SHA256_MAJ(a, b, c)
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL, 0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL
+};
+
+void sha256_short(const uint8_t *msg, uint8_t len, uint8_t *digest) {
+    uint32_t w[16];
+    uint32_t a, b, c, d, e, f, g, h, t;
+    uint8_t i;
+
+    // Pad into the one block: message, 0x80, zeros, bit length.
+    for (i = 0; i < 16; i++) {
+        w[i] = 0;
+    }
+    for (i = 0; i < len; i++) {
+        w[i >> 2] |= (uint32_t)msg[i] << (24 - ((i & 0x3) << 3));
+    }
+    w[len >> 2] |= 0x80UL << (24 - ((len & 0x3) << 3));
+    w[15] = (uint32_t)len << 3;
+
+    a = sha256_h0[0]; b = sha256_h0[1]; c = sha256_h0[2]; d = sha256_h0[3];
+    e = sha256_h0[4]; f = sha256_h0[5]; g = sha256_h0[6]; h = sha256_h0[7];
+
+    for (i = 0; i < 64; i += 8) {
+        if (i >= 16) {
+            uint8_t j;
+            for (j = i; j < i + 8; j++) {               // message schedule, in place
+                w[j & 15] += SHA256_G1(w[(j - 2) & 15]) + w[(j - 7) & 15] + SHA256_G0(w[(j - 15) & 15]);
+            }
+        }
+        SHA256_ROUND(a, b, c, d, e, f, g, h, i + 0);
+        SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1);
+        SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2);
+        SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3);
+        SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4);
+        SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5);
+        SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6);
+        SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+
+    w[0] = sha256_h0[0] + a; w[1] = sha256_h0[1] + b; w[2] = sha256_h0[2] + c; w[3] = sha256_h0[3] + d;
+    w[4] = sha256_h0[4] + e; w[5] = sha256_h0[5] + f; w[6] = sha256_h0[6] + g; w[7] = sha256_h0[7] + h;
+    for (i = 0; i < SHA256_BYTES; i++) {
+        digest[i] = (uint8_t)(w[i >> 2] >> (24 - ((i & 0x3) << 3)));
+    }
+
+    for (i = 0; i < 16; i++) {
+        ((volatile uint32_t *)w)[i] = 0;                // the block held the PIN
+    }
+} // end sha256_short
@@ -0,0 +1,26 @@
+/*
+ * sha256.h
+ *
+ *  SHA-256 of short messages, for PIN hashing.
+ *
+ *  Only messages that fit one 64-byte block after padding (up to 55
+ *  bytes) are supported, which is all an iterated PIN hash needs: every
+ *  call is exactly one compression. The 64 rounds are unrolled by eight
+ *  so the working variables never move between registers and memory.
+ *  SHA-256 has no multiplications, the MPY32 is not involved.
+ */
+
+#ifndef SHA256_H_
+#define SHA256_H_
+
+#include <stdint.h>
+
+#define SHA256_BYTES        32
+#define SHA256_SHORT_MAX    55                          // longest message that pads into one block
+
+/* ====================================================================
+ * SHA-256 Prototype Definitions
+ * ==================================================================== */
+void sha256_short(const uint8_t *, uint8_t, uint8_t *); // message, length <= SHA256_SHORT_MAX, digest (may be the message)
+
+#endif /* SHA256_H_ */
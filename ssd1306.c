@@ -50,7 +50,7 @@ void ssd1306_init(void) {
     ssd1306_command(SSD1306_SETCOMPINS);                                // 0xDA
     ssd1306_command(0x12);
     ssd1306_command(SSD1306_SETCONTRAST);                               // 0x81
-    ssd1306_command(0xCF);
+    ssd1306_command(SSD1306_DEFAULTCONTRAST);
 
     ssd1306_command(SSD1306_SETPRECHARGE);                              // 0xd9
     ssd1306_command(0xF1);
@@ -71,6 +71,33 @@ void ssd1306_command(unsigned char command) {
     i2c_write(buffer, 2);
 } // end ssd1306_command
 
+void ssd1306_commandList(const unsigned char *commands, uint8_t count) {
+    if (count > 16) {
+        count = 16;                                                     // constrain to transmit buffer size
+    }
+
+    buffer[0] = 0x00;                                                   // Co = 0, D/C = 0: command stream follows
+    uint8_t i;
+    for (i = 0; i < count; i++) {
+        buffer[i+1] = commands[i];
+    }
+
+    i2c_write(buffer, count + 1);                                       // one transaction instead of one per command
+} // end ssd1306_commandList
+
+void ssd1306_setWindow(uint8_t column0, uint8_t column1, uint8_t page0, uint8_t page1) {
+    unsigned char window[6];
+
+    window[0] = SSD1306_COLUMNADDR;
+    window[1] = column0;                                                // Column start address
+    window[2] = column1;                                                // Column end address
+    window[3] = SSD1306_PAGEADDR;
+    window[4] = page0;                                                  // Page start address
+    window[5] = page1;                                                  // Page end address
+
+    ssd1306_commandList(window, 6);
+} // end ssd1306_setWindow
+
 void ssd1306_clearDisplay(void) {
 
     ssd1306_setPosition(0, 0);
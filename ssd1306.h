@@ -32,6 +32,7 @@ unsigned char buffer[17];                       // buffer for data transmission
 #define SSD1306_128_64
 
 #define SSD1306_SETCONTRAST             0x81
+#define SSD1306_DEFAULTCONTRAST         0xCF
 #define SSD1306_DISPLAYALLON_RESUME     0xA4
 #define SSD1306_DISPLAYALLON            0xA5
 #define SSD1306_NORMALDISPLAY           0xA6
@@ -65,6 +66,11 @@ unsigned char buffer[17];                       // buffer for data transmission
 
 #define SSD1306_CHARGEPUMP              0x8D
 
+#define SSD1306_FADEBLINK               0x23            // A[5:4] = 00 off, 10 fade out, 11 blink
+#define SSD1306_FADE_OFF                0x00
+#define SSD1306_FADE_OUT                0x20
+#define SSD1306_FADE_BLINK              0x30
+
 #define SSD1306_EXTERNALVCC             0x1
 #define SSD1306_SWITCHCAPVCC            0x2
 
@@ -83,6 +89,8 @@ unsigned char buffer[17];                       // buffer for data transmission
  * ==================================================================== */
 void ssd1306_init(void);
 void ssd1306_command(unsigned char);
+void ssd1306_commandList(const unsigned char *, uint8_t);
+void ssd1306_setWindow(uint8_t, uint8_t, uint8_t, uint8_t);
 void ssd1306_clearDisplay(void);
 void ssd1306_setPosition(uint8_t, uint8_t);
 void ssd1306_printText(uint8_t, uint8_t, char *);
@@ -0,0 +1,65 @@
+/*
+ * ssd1306_burnin.c
+ *
+ *  Hardware pixel shift for burn-in mitigation.
+ */
+
+#include "ssd1306_burnin.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "ssd1306.h"
+#include "timer.h"
+
+// Row offsets visited in turn; negative shifts wrap to the bottom rows.
+static const uint8_t burnin_orbit[] = {0, 1, 2, 1, 0, SSD1306_LCDHEIGHT - 1, SSD1306_LCDHEIGHT - 2, SSD1306_LCDHEIGHT - 1};
+
+static int8_t burnin_timer = TIMER_NONE;
+static volatile uint8_t burnin_due;                                     // set by burnin_timer
+static uint8_t burnin_index;
+
+static void burnin_tick(void) {
+    burnin_due = 1;                                                     // timer callback, interrupt context
+} // end burnin_tick
+
+static void burnin_setOffset(uint8_t rows) {
+    unsigned char command[2];
+
+    command[0] = SSD1306_SETDISPLAYOFFSET;
+    command[1] = rows;
+    ssd1306_commandList(command, 2);
+} // end burnin_setOffset
+
+void burnin_enable(uint16_t seconds) {
+    if (seconds == 0) {
+        seconds = 1;
+    } else if (seconds > BURNIN_MAX_INTERVAL_S) {
+        seconds = BURNIN_MAX_INTERVAL_S;
+    }
+    uint32_t interval = (uint32_t)seconds * 1000;
+
+    timer_stop(burnin_timer);
+    burnin_timer = timer_start(interval, interval, burnin_tick);
+} // end burnin_enable
+
+void burnin_disable(void) {
+    timer_stop(burnin_timer);
+    burnin_timer = TIMER_NONE;
+    burnin_due = 0;
+    if (burnin_index) {
+        burnin_index = 0;
+        burnin_setOffset(0);                                            // back to the unshifted image
+    }
+} // end burnin_disable
+
+void burnin_service(void) {
+    if (!burnin_due) {
+        return;                                                         // next shift not due yet
+    }
+    burnin_due = 0;
+
+    burnin_index++;
+    if (burnin_index >= sizeof(burnin_orbit)) {
+        burnin_index = 0;
+    }
+    burnin_setOffset(burnin_orbit[burnin_index]);
+} // end burnin_service
@@ -0,0 +1,26 @@
+/*
+ * ssd1306_burnin.h
+ *
+ *  OLED burn-in mitigation. While enabled, the whole image is nudged a row
+ *  or two up and down on a slow orbit using SSD1306_SETDISPLAYOFFSET, which
+ *  remaps COM lines without touching GDDRAM. Each shift is one 3-byte I2C
+ *  transaction, scheduled from a software timer on the ACLK timebase
+ *  (timer.h) so it keeps time in LPM3.
+ *
+ *  The offset register is independent of SSD1306_SETSTARTLINE, so it stacks
+ *  with anything that scrolls through the start line.
+ */
+
+#ifndef SSD1306_BURNIN_H_
+#define SSD1306_BURNIN_H_
+
+#include <stdint.h>
+
+#define BURNIN_DEFAULT_INTERVAL_S   60              // seconds between shifts
+#define BURNIN_MAX_INTERVAL_S       1000            // software timer range limit
+
+void burnin_enable(uint16_t);                       // interval in seconds
+void burnin_disable(void);
+void burnin_service(void);
+
+#endif /* SSD1306_BURNIN_H_ */
@@ -0,0 +1,53 @@
+/*
+ * ssd1306_console.c
+ *
+ *  GDDRAM ring buffer console scrolled with the start line register.
+ */
+
+#include "ssd1306_console.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "ssd1306.h"
+#include "i2c.h"
+
+static uint8_t console_head;                                            // page the next line is written to
+
+void console_init(void) {
+    ssd1306_clearDisplay();
+    ssd1306_command(SSD1306_SETSTARTLINE | 0x0);
+    console_head = 0;
+} // end console_init
+
+void console_println(const char *text) {
+    char line[CONSOLE_COLUMNS + 1];
+    uint8_t n = 0;
+
+    while ((n < CONSOLE_COLUMNS) && (text[n] != '\0')) {
+        line[n] = text[n];                                              // truncate, printText would wrap
+        n++;
+    }
+    line[n] = '\0';
+
+    uint8_t page = console_head;
+    ssd1306_printText(0, page, line);
+
+    uint8_t pad = SSD1306_LCDWIDTH - (n * 6);                           // blank the rest of the old line
+    while (pad) {
+        uint8_t chunk = (pad > 16) ? 16 : pad;
+        buffer[0] = 0x40;
+        uint8_t i;
+        for (i = 1; i <= chunk; i++) {
+            buffer[i] = 0x0;
+        }
+        i2c_write(buffer, chunk + 1);
+        pad -= chunk;
+    }
+
+    console_head = (page + 1) & (CONSOLE_LINES - 1);
+    ssd1306_command(SSD1306_SETSTARTLINE | (console_head << 3));        // oldest line on top, newest at the bottom
+} // end console_println
+
+void console_exit(void) {
+    ssd1306_command(SSD1306_SETSTARTLINE | 0x0);                        // normal page origin for the other views
+    ssd1306_clearDisplay();
+} // end console_exit
@@ -0,0 +1,25 @@
+/*
+ * ssd1306_console.h
+ *
+ *  Scrolling text console for diagnostics and audit views.
+ *
+ *  GDDRAM is used as a ring of 8 text lines, one per page. Appending a line
+ *  rewrites only the page that held the oldest line (128 data bytes through
+ *  the ssd1306_printText glyph path) and then moves the visible origin with
+ *  a single SSD1306_SETSTARTLINE command so the new line shows at the
+ *  bottom. Bus cost per line is constant, however long the log gets.
+ */
+
+#ifndef SSD1306_CONSOLE_H_
+#define SSD1306_CONSOLE_H_
+
+#include <stdint.h>
+
+#define CONSOLE_LINES       8                       // one text line per GDDRAM page
+#define CONSOLE_COLUMNS     21                      // 6-pixel glyph cells that fit in 128 columns
+
+void console_init(void);
+void console_println(const char *);
+void console_exit(void);
+
+#endif /* SSD1306_CONSOLE_H_ */
@@ -0,0 +1,108 @@
+/*
+ * ssd1306_fx.c
+ *
+ *  Timer-paced display effects using SSD1306 commands only.
+ */
+
+#include "ssd1306_fx.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "ssd1306.h"
+#include "timer.h"
+
+static uint8_t fx_mode = FX_NONE;                                       // running timed effect
+static uint16_t fx_step;                                                // steps done so far
+static uint16_t fx_steps;                                               // steps in the whole effect, up to 2 * 255
+static uint8_t fx_target;                                               // contrast pulse peak
+static int8_t fx_timer = TIMER_NONE;                                    // paces the steps
+static volatile uint8_t fx_due;                                         // steps due, set by fx_timer
+
+static void fx_tick(void) {
+    fx_due = 1;                                                         // timer callback, interrupt context
+} // end fx_tick
+
+static void fx_start(uint8_t mode, uint16_t steps, uint16_t periodMs) {
+    timer_stop(fx_timer);
+    fx_mode = mode;
+    fx_step = 0;
+    fx_steps = steps;
+    fx_due = 1;                                                         // first step on the next service
+    fx_timer = timer_start(periodMs, periodMs, fx_tick);
+} // end fx_start
+
+static void fx_setContrast(uint8_t level) {
+    unsigned char command[2];
+
+    command[0] = SSD1306_SETCONTRAST;
+    command[1] = level;
+    ssd1306_commandList(command, 2);
+} // end fx_setContrast
+
+static void fx_setFade(uint8_t mode, uint8_t interval) {
+    unsigned char command[2];
+
+    command[0] = SSD1306_FADEBLINK;
+    command[1] = mode | (interval & 0x0F);
+    ssd1306_commandList(command, 2);
+} // end fx_setFade
+
+void fx_invertFlash(uint8_t count, uint16_t periodMs) {
+    fx_start(FX_INVERT, (uint16_t)count << 1, periodMs >> 1);                     // invert and restore per flash
+} // end fx_invertFlash
+
+void fx_contrastPulse(uint8_t target, uint8_t steps) {
+    if (steps == 0) {
+        steps = 1;
+    }
+    fx_target = target;
+    fx_start(FX_CONTRAST, (uint16_t)steps << 1, FX_CONTRAST_STEP_MS);             // ramp to target and back
+} // end fx_contrastPulse
+
+void fx_fadeOut(uint8_t interval) {
+    fx_setFade(SSD1306_FADE_OUT, interval);                             // runs in the controller, no further traffic
+} // end fx_fadeOut
+
+void fx_blink(uint8_t interval) {
+    fx_setFade(SSD1306_FADE_BLINK, interval);                           // runs in the controller, no further traffic
+} // end fx_blink
+
+void fx_stop(void) {
+    fx_mode = FX_NONE;
+    timer_stop(fx_timer);
+    fx_timer = TIMER_NONE;
+
+    unsigned char command[5];
+    command[0] = SSD1306_FADEBLINK;
+    command[1] = SSD1306_FADE_OFF;
+    command[2] = SSD1306_NORMALDISPLAY;
+    command[3] = SSD1306_SETCONTRAST;
+    command[4] = SSD1306_DEFAULTCONTRAST;
+    ssd1306_commandList(command, 5);
+} // end fx_stop
+
+uint8_t fx_busy(void) {
+    return fx_mode != FX_NONE;
+} // end fx_busy
+
+void fx_service(void) {
+    if ((fx_mode == FX_NONE) || !fx_due) {
+        return;                                                         // next step not due yet
+    }
+    fx_due = 0;
+    fx_step++;
+
+    if (fx_mode == FX_INVERT) {
+        ssd1306_command((fx_step & 0x1) ? SSD1306_INVERTDISPLAY : SSD1306_NORMALDISPLAY);
+    } else {
+        uint16_t half = fx_steps >> 1;
+        uint16_t distance = (fx_step <= half) ? fx_step : (fx_steps - fx_step);
+        int16_t span = (int16_t)fx_target - SSD1306_DEFAULTCONTRAST;
+        fx_setContrast(SSD1306_DEFAULTCONTRAST + ((int32_t)span * distance) / half);   // 32 bits: 255 * 255
+    }
+
+    if (fx_step >= fx_steps) {
+        fx_mode = FX_NONE;                                              // last step restored the normal state
+        timer_stop(fx_timer);
+        fx_timer = TIMER_NONE;
+    }
+} // end fx_service
@@ -0,0 +1,33 @@
+/*
+ * ssd1306_fx.h
+ *
+ *  Display effects done by the SSD1306 itself: inverting, contrast ramps
+ *  and the controller's built-in fade out / blink mode. None of them touch
+ *  GDDRAM, so feedback costs a few command bytes instead of a redraw.
+ *
+ *  Timed effects are paced by a software timer (timer.h) that wakes the main
+ *  loop once per step. Start one with the fx_* calls and call fx_service()
+ *  from the main loop; it sends the next command only when a step is due
+ *  and returns immediately otherwise.
+ */
+
+#ifndef SSD1306_FX_H_
+#define SSD1306_FX_H_
+
+#include <stdint.h>
+
+#define FX_NONE         0
+#define FX_INVERT       1
+#define FX_CONTRAST     2
+
+#define FX_CONTRAST_STEP_MS     30              // contrast ramp step
+
+void fx_invertFlash(uint8_t, uint16_t);         // flash count, period in ms
+void fx_contrastPulse(uint8_t, uint8_t);        // target contrast, steps per ramp
+void fx_fadeOut(uint8_t);                       // hardware fade, 8 * (n + 1) frames per step, n = 0..15
+void fx_blink(uint8_t);                         // hardware blink, 8 * (n + 1) frames per step, n = 0..15
+void fx_stop(void);
+uint8_t fx_busy(void);
+void fx_service(void);
+
+#endif /* SSD1306_FX_H_ */
@@ -0,0 +1,331 @@
+/*
+ * ssd1306_gfx.c
+ *
+ *  2D graphics primitives on a GDDRAM-shaped framebuffer.
+ */
+
+#include "ssd1306_gfx.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "ssd1306.h"
+#include "i2c.h"
+
+/* ====================================================================
+ * Framebuffer
+ *
+ * Stored as words so spans can be applied two columns at a time; a byte
+ * view of the same storage is used for single columns and for streaming.
+ * ==================================================================== */
+static uint16_t gfx_words[GFX_PAGES][SSD1306_LCDWIDTH / 2];
+#define GFX_ROW(page)   ((uint8_t *)gfx_words[page])
+
+#if GFX_PAGES != 8
+#error Dirty range initializers below assume 8 pages
+#endif
+static uint8_t gfx_dirtyMin[GFX_PAGES] = {                              // first modified column per page
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF                      // min > max: nothing to send
+};
+static uint8_t gfx_dirtyMax[GFX_PAGES];                                 // last modified column per page
+
+static void gfx_markDirty(uint8_t page, uint8_t column0, uint8_t column1) {
+    if (column0 < gfx_dirtyMin[page]) {
+        gfx_dirtyMin[page] = column0;
+    }
+    if (column1 > gfx_dirtyMax[page]) {
+        gfx_dirtyMax[page] = column1;
+    }
+} // end gfx_markDirty
+
+static void gfx_applyByte(uint8_t *dst, uint8_t mask, uint8_t color) {
+    if (color == GFX_WHITE) {
+        *dst |= mask;
+    } else if (color == GFX_BLACK) {
+        *dst &= ~mask;
+    } else {
+        *dst ^= mask;
+    }
+} // end gfx_applyByte
+
+// Apply the same vertical bit mask to columns column0..column1 of one page.
+// An odd leading and trailing column are done bytewise, the rest wordwise.
+static void gfx_spanPage(uint8_t page, uint8_t column0, uint8_t column1, uint8_t mask, uint8_t color) {
+    uint8_t *row = GFX_ROW(page);
+    uint8_t x = column0;
+
+    gfx_markDirty(page, column0, column1);
+
+    if (x & 0x1) {
+        gfx_applyByte(&row[x], mask, color);
+        x++;
+    }
+
+    uint16_t wmask = ((uint16_t)mask << 8) | mask;
+    uint16_t *w = &gfx_words[page][x >> 1];
+    uint8_t n = (uint8_t)(column1 + 1 - x) >> 1;
+
+    x += n << 1;
+    if (color == GFX_WHITE) {
+        for (; n > 0; n--) {
+            *w++ |= wmask;
+        }
+    } else if (color == GFX_BLACK) {
+        wmask = ~wmask;
+        for (; n > 0; n--) {
+            *w++ &= wmask;
+        }
+    } else {
+        for (; n > 0; n--) {
+            *w++ ^= wmask;
+        }
+    }
+
+    if (x <= column1) {
+        gfx_applyByte(&row[x], mask, color);
+    }
+} // end gfx_spanPage
+
+void gfx_clear(void) {
+    uint8_t page;
+    for (page = 0; page < GFX_PAGES; page++) {
+        uint16_t *w = gfx_words[page];
+        uint8_t n;
+        for (n = SSD1306_LCDWIDTH / 2; n > 0; n--) {                    // count down for loops when possible for ULP
+            *w++ = 0;
+        }
+        gfx_dirtyMin[page] = 0;
+        gfx_dirtyMax[page] = SSD1306_LCDWIDTH - 1;
+    }
+} // end gfx_clear
+
+void gfx_drawPixel(uint8_t x, uint8_t y, uint8_t color) {
+    if ((x >= SSD1306_LCDWIDTH) || (y >= SSD1306_LCDHEIGHT)) {
+        return;
+    }
+
+    gfx_applyByte(&GFX_ROW(y >> 3)[x], 1 << (y & 0x7), color);
+    gfx_markDirty(y >> 3, x, x);
+} // end gfx_drawPixel
+
+void gfx_fillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color) {
+    if ((x >= SSD1306_LCDWIDTH) || (y >= SSD1306_LCDHEIGHT) || (w == 0) || (h == 0)) {
+        return;
+    }
+    if (w > SSD1306_LCDWIDTH - x) {
+        w = SSD1306_LCDWIDTH - x;                                       // clip to right edge
+    }
+    if (h > SSD1306_LCDHEIGHT - y) {
+        h = SSD1306_LCDHEIGHT - y;                                      // clip to bottom edge
+    }
+
+    uint8_t y1 = y + h - 1;
+    uint8_t x1 = x + w - 1;
+    uint8_t page0 = y >> 3;
+    uint8_t page1 = y1 >> 3;
+    uint8_t page;
+
+    for (page = page0; page <= page1; page++) {
+        uint8_t mask = 0xFF;
+        if (page == page0) {
+            mask &= 0xFF << (y & 0x7);
+        }
+        if (page == page1) {
+            mask &= 0xFF >> (7 - (y1 & 0x7));
+        }
+        gfx_spanPage(page, x, x1, mask, color);
+    }
+} // end gfx_fillRect
+
+void gfx_drawHLine(uint8_t x, uint8_t y, uint8_t w, uint8_t color) {
+    gfx_fillRect(x, y, w, 1, color);
+} // end gfx_drawHLine
+
+void gfx_drawVLine(uint8_t x, uint8_t y, uint8_t h, uint8_t color) {
+    gfx_fillRect(x, y, 1, h, color);                                    // one masked byte per page
+} // end gfx_drawVLine
+
+void gfx_drawRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color) {
+    if ((w == 0) || (h == 0)) {
+        return;
+    }
+
+    uint16_t x1 = (uint16_t)x + w - 1;                                  // 16 bits: an edge past 255 must
+    uint16_t y1 = (uint16_t)y + h - 1;                                  // be clipped, not wrap on screen
+
+    gfx_drawHLine(x, y, w, color);
+    if ((h > 1) && (y1 < SSD1306_LCDHEIGHT)) {
+        gfx_drawHLine(x, y1, w, color);
+    }
+    if (h > 2) {
+        gfx_drawVLine(x, y + 1, h - 2, color);
+        if ((w > 1) && (x1 < SSD1306_LCDWIDTH)) {
+            gfx_drawVLine(x1, y + 1, h - 2, color);
+        }
+    }
+} // end gfx_drawRect
+
+// Bresenham, but consecutive pixels on the same row (or column for steep
+// lines) are collected into one run and drawn as a single span.
+void gfx_drawLine(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color) {
+    int16_t dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
+    int16_t dy = (y1 > y0) ? (y1 - y0) : (y0 - y1);
+    int8_t sx = (x1 > x0) ? 1 : -1;
+    int8_t sy = (y1 > y0) ? 1 : -1;
+    int16_t x = x0;
+    int16_t y = y0;
+    int16_t run = x0;
+    int16_t err;
+
+    if (dx >= dy) {
+        err = dx >> 1;
+        for (;;) {
+            if ((x == x1) || ((err - dy) < 0)) {
+                if (run <= x) {
+                    gfx_drawHLine(run, y, x - run + 1, color);
+                } else {
+                    gfx_drawHLine(x, y, run - x + 1, color);
+                }
+                if (x == x1) {
+                    break;
+                }
+                y += sy;
+                err += dx;
+                run = x + sx;
+            }
+            err -= dy;
+            x += sx;
+        }
+    } else {
+        run = y0;
+        err = dy >> 1;
+        for (;;) {
+            if ((y == y1) || ((err - dx) < 0)) {
+                if (run <= y) {
+                    gfx_drawVLine(x, run, y - run + 1, color);
+                } else {
+                    gfx_drawVLine(x, y, run - y + 1, color);
+                }
+                if (y == y1) {
+                    break;
+                }
+                x += sx;
+                err += dy;
+                run = y + sy;
+            }
+            err -= dx;
+            y += sy;
+        }
+    }
+} // end gfx_drawLine
+
+// Blit a 1-bpp bitmap stored in page layout: ceil(h / 8) rows of w bytes,
+// LSB on top, the same format the SSD1306 uses. Set bits are drawn with
+// color, clear bits leave the framebuffer untouched.
+//
+// Each source byte is shifted into a 16-bit value spanning two pages; two
+// neighbouring columns are then merged into one word per page and applied
+// wordwise, like the spans. The color is turned into two masks up front
+// so the inner loop has no branch per byte: covered bits are cleared
+// where clr is set, then toggled where tgl is set.
+void gfx_drawBitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8_t *bitmap, uint8_t color) {
+    if ((x >= SSD1306_LCDWIDTH) || (y >= SSD1306_LCDHEIGHT) || (w == 0) || (h == 0)) {
+        return;
+    }
+
+    uint8_t pages = (h + 7) >> 3;
+    uint8_t shift = y & 0x7;
+    uint8_t visible = (w > SSD1306_LCDWIDTH - x) ? (SSD1306_LCDWIDTH - x) : w;
+    uint16_t clr = (color == GFX_INVERT) ? 0 : 0xFFFF;                  // WHITE and BLACK clear first
+    uint16_t tgl = (color == GFX_BLACK) ? 0 : 0xFFFF;                   // WHITE and INVERT toggle
+    uint8_t sp;
+
+    for (sp = 0; sp < pages; sp++) {
+        uint8_t page = (y >> 3) + sp;
+        if (page >= GFX_PAGES) {
+            break;
+        }
+
+        uint8_t mask = 0xFF;
+        if ((sp == pages - 1) && (h & 0x7)) {
+            mask = 0xFF >> (8 - (h & 0x7));                             // drop rows below the bitmap
+        }
+
+        const uint8_t *src = &bitmap[(uint16_t)sp * w];
+        uint8_t hasHi = shift && (page + 1 < GFX_PAGES);                // one source byte spans two pages
+        uint8_t *lo = GFX_ROW(page);
+        uint8_t *hi = GFX_ROW(page + (hasHi ? 1 : 0));
+        uint8_t c = 0;
+        uint16_t v;
+
+        if (x & 0x1) {                                                  // odd leading column, bytewise
+            v = (uint16_t)(src[0] & mask) << shift;
+            lo[x] = (lo[x] & ~((uint8_t)v & clr)) ^ ((uint8_t)v & tgl);
+            if (hasHi) {
+                hi[x] = (hi[x] & ~((v >> 8) & clr)) ^ ((v >> 8) & tgl);
+            }
+            c = 1;
+        }
+
+        uint16_t *wlo = &gfx_words[page][(x + c) >> 1];
+        uint16_t *whi = &gfx_words[page + (hasHi ? 1 : 0)][(x + c) >> 1];
+        for (; c + 1 < visible; c += 2) {
+            uint16_t v0 = (uint16_t)(src[c] & mask) << shift;
+            uint16_t v1 = (uint16_t)(src[c + 1] & mask) << shift;
+            uint16_t m = (v0 & 0x00FF) | (v1 << 8);                     // low page, two columns
+            *wlo = (*wlo & ~(m & clr)) ^ (m & tgl);
+            wlo++;
+            if (hasHi) {
+                m = (v0 >> 8) | (v1 & 0xFF00);                          // high page, two columns
+                *whi = (*whi & ~(m & clr)) ^ (m & tgl);
+            }
+            whi++;
+        }
+
+        if (c < visible) {                                              // odd trailing column
+            uint8_t col = x + c;
+            v = (uint16_t)(src[c] & mask) << shift;
+            lo[col] = (lo[col] & ~((uint8_t)v & clr)) ^ ((uint8_t)v & tgl);
+            if (hasHi) {
+                hi[col] = (hi[col] & ~((v >> 8) & clr)) ^ ((v >> 8) & tgl);
+            }
+        }
+
+        gfx_markDirty(page, x, x + visible - 1);
+        if (hasHi) {
+            gfx_markDirty(page + 1, x, x + visible - 1);
+        }
+    }
+} // end gfx_drawBitmap
+
+void gfx_display(void) {
+    uint8_t page;
+    for (page = 0; page < GFX_PAGES; page++) {
+        if (gfx_dirtyMin[page] > gfx_dirtyMax[page]) {
+            continue;                                                   // nothing changed on this page
+        }
+
+        uint8_t x = gfx_dirtyMin[page];
+        uint8_t end = gfx_dirtyMax[page];
+        const uint8_t *row = GFX_ROW(page);
+
+        ssd1306_setWindow(x, end, page, page);
+
+        while (x <= end) {
+            uint8_t n = end - x + 1;
+            if (n > 16) {
+                n = 16;                                                 // 16 data bytes per transmit buffer
+            }
+
+            buffer[0] = 0x40;
+            uint8_t i;
+            for (i = 0; i < n; i++) {
+                buffer[i+1] = row[x + i];
+            }
+
+            i2c_write(buffer, n + 1);
+            x += n;
+        }
+
+        gfx_dirtyMin[page] = 0xFF;
+        gfx_dirtyMax[page] = 0;
+    }
+} // end gfx_display
@@ -0,0 +1,44 @@
+/*
+ * ssd1306_gfx.h
+ *
+ *  2D graphics primitives for the SSD1306 OLED.
+ *
+ *  Drawing goes into a RAM framebuffer laid out exactly like the SSD1306
+ *  GDDRAM (8 pages of 128 columns, one byte = 8 vertical pixels, LSB on top),
+ *  so gfx_display() can stream it without any conversion. Only the column
+ *  range touched on each page since the last gfx_display() is sent.
+ *
+ *  Spans, filled rectangles and bitmaps are applied 16 bits (two columns)
+ *  at a time. tools/host/gfx_bench.c checks them against a pixel-by-pixel
+ *  reference and measures pixels per cycle on the host.
+ */
+
+#ifndef SSD1306_GFX_H_
+#define SSD1306_GFX_H_
+
+#include <stdint.h>
+#include "ssd1306.h"
+
+/* ====================================================================
+ * Framebuffer Geometry and Colors
+ * ==================================================================== */
+#define GFX_PAGES       (SSD1306_LCDHEIGHT / 8)
+
+#define GFX_BLACK       0                       // clear pixels
+#define GFX_WHITE       1                       // set pixels
+#define GFX_INVERT      2                       // toggle pixels
+
+/* ====================================================================
+ * Graphics Prototype Definitions
+ * ==================================================================== */
+void gfx_clear(void);
+void gfx_drawPixel(uint8_t, uint8_t, uint8_t);
+void gfx_drawHLine(uint8_t, uint8_t, uint8_t, uint8_t);
+void gfx_drawVLine(uint8_t, uint8_t, uint8_t, uint8_t);
+void gfx_drawLine(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);
+void gfx_drawRect(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);
+void gfx_fillRect(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);
+void gfx_drawBitmap(uint8_t, uint8_t, uint8_t, uint8_t, const uint8_t *, uint8_t);
+void gfx_display(void);
+
+#endif /* SSD1306_GFX_H_ */
@@ -0,0 +1,92 @@
+/*
+ * ssd1306_image.c
+ *
+ *  Streaming decoder for images generated by tools/img_encode.py.
+ */
+
+#include "ssd1306_image.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "ssd1306.h"
+#include "i2c.h"
+
+static uint8_t img_history[IMG_WINDOW];                                 // last IMG_WINDOW output bytes
+static uint8_t img_pos;                                                 // write index into img_history
+static uint8_t img_fill;                                                // bytes waiting in the transmit buffer
+
+static void img_flush(void) {
+    if (img_fill) {
+        buffer[0] = 0x40;                                               // Co = 0, D/C = 1: data stream follows
+        i2c_write(buffer, img_fill + 1);
+        img_fill = 0;
+    }
+} // end img_flush
+
+static void img_emit(uint8_t b) {
+    img_history[img_pos++ & (IMG_WINDOW - 1)] = b;
+    buffer[++img_fill] = b;
+    if (img_fill == 16) {
+        img_flush();                                                    // transmit buffer holds 16 data bytes
+    }
+} // end img_emit
+
+void ssd1306_drawImage(uint8_t x, uint8_t page, const uint8_t *image) {
+    uint8_t width = img_width(image);
+    uint8_t pages = img_pages(image);
+    uint16_t remaining = (uint16_t)width * pages;
+    const uint8_t *src = &image[2];
+
+    if ((x + width > SSD1306_LCDWIDTH) || (page + pages > 8)) {
+        return;                                                         // image must fit entirely
+    }
+
+    ssd1306_setWindow(x, x + width - 1, page, page + pages - 1);        // GDDRAM wraps inside the window
+    img_pos = 0;
+    img_fill = 0;
+
+    if (image[1] & IMG_RAW) {
+        while (remaining--) {
+            img_emit(*src++);
+        }
+        img_flush();
+        return;
+    }
+
+    while (remaining) {
+        uint8_t ctrl = *src++;
+        uint8_t n;
+
+        if ((ctrl & 0xC0) == 0xC0) {                                    // copy from history
+            uint8_t from = img_pos - (*src++ + 1);
+            n = (ctrl & 0x3F) + 3;
+            if (n > remaining) {
+                n = remaining;
+            }
+            remaining -= n;
+            while (n--) {
+                img_emit(img_history[from++ & (IMG_WINDOW - 1)]);
+            }
+        } else if (ctrl & 0x80) {                                       // run of one byte
+            uint8_t b = *src++;
+            n = (ctrl & 0x3F) + 2;
+            if (n > remaining) {
+                n = remaining;
+            }
+            remaining -= n;
+            while (n--) {
+                img_emit(b);
+            }
+        } else {                                                        // literal bytes
+            n = (ctrl & 0x3F) + 1;
+            if (n > remaining) {
+                n = remaining;
+            }
+            remaining -= n;
+            while (n--) {
+                img_emit(*src++);
+            }
+        }
+    }
+
+    img_flush();
+} // end ssd1306_drawImage
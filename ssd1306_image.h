@@ -0,0 +1,34 @@
+/*
+ * ssd1306_image.h
+ *
+ *  Compressed 1-bpp images streamed straight into SSD1306 GDDRAM.
+ *
+ *  Images are produced offline by tools/img_encode.py from PBM files. The
+ *  payload is the GDDRAM byte stream (page layout) compressed with literal,
+ *  run and back-reference packets. The decoder keeps only IMG_WINDOW bytes
+ *  of history and hands the output to i2c_write() 16 bytes at a time, so no
+ *  frame is ever held in RAM.
+ *
+ *  byte 0      width in columns (1..128)
+ *  byte 1      height in pages (1..8), IMG_RAW set if stored uncompressed
+ *  packets
+ *      0x00..0x3F  literal: the next (n + 1) bytes are copied
+ *      0x80..0xBF  run:     the next byte is repeated (n & 0x3F) + 2 times
+ *      0xC0..0xFF  copy:    (n & 0x3F) + 3 bytes are copied from
+ *                           (next byte + 1) bytes back in the output
+ */
+
+#ifndef SSD1306_IMAGE_H_
+#define SSD1306_IMAGE_H_
+
+#include <stdint.h>
+
+#define IMG_WINDOW      128                     // back-reference history, one page row
+#define IMG_RAW         0x80                    // page count flag: payload is not compressed
+
+#define img_width(img)  ((img)[0])
+#define img_pages(img)  ((img)[1] & 0x0F)
+
+void ssd1306_drawImage(uint8_t, uint8_t, const uint8_t *);
+
+#endif /* SSD1306_IMAGE_H_ */
@@ -0,0 +1,257 @@
+/*
+ * timer.c
+ *
+ *  Tickless millisecond timebase and software timers on Timer_B0.
+ */
+
+#include "timer.h"
+#include <msp430.h>
+#include <stdint.h>
+#include "clock.h"
+#include "power.h"
+
+#define TIMER_MIN_LEAD      2                           // ACLK cycles
+#define TIMER_MAX_LEAD      0x7FFF                      // keeps CCR0 comparisons unambiguous
+
+typedef struct {
+    uint32_t deadline;                                  // ACLK count the timer fires at
+    uint32_t period;                                    // ACLK cycles, 0 = one-shot
+    timer_callback_t callback;
+    uint8_t active;
+} timer_slot_t;
+
+static timer_slot_t timer_slots[TIMER_SLOTS];
+static volatile uint32_t timer_overflows;               // counter bits above TB0R
+volatile uint8_t timer_wakePending;
+static volatile uint8_t timer_sleepFired;               // sleep_ms() one-shot has run
+
+// TB0R runs from ACLK, asynchronous to MCLK: read until two reads agree.
+static uint16_t timer_readCount(void) {
+    uint16_t a;
+    uint16_t b = TB0R;
+
+    do {
+        a = b;
+        b = TB0R;
+    } while (a != b);
+
+    return a;
+} // end timer_readCount
+
+// 32-bit ACLK count; call with interrupts disabled.
+static uint32_t timer_aclkLocked(void) {
+    uint16_t count = timer_readCount();
+    uint32_t high = timer_overflows;
+
+    if ((TB0CTL & TBIFG) && (count < 0x8000)) {
+        high++;                                         // wrapped, overflow ISR not run yet
+    }
+
+    return (high << 16) | count;
+} // end timer_aclkLocked
+
+// Point CCR0 at the earliest deadline, or TIMER_MAX_LEAD ahead for deadlines
+// further out, in which case the CCR0 ISR just re-arms. Interrupts disabled.
+static void timer_reschedule(void) {
+    uint32_t now = timer_aclkLocked();
+    uint32_t soonest = TIMER_MAX_LEAD;
+    uint8_t active = 0;
+    uint8_t i;
+
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        if (timer_slots[i].active) {
+            active = 1;
+            int32_t delta = (int32_t)(timer_slots[i].deadline - now);
+            if (delta < TIMER_MIN_LEAD) {
+                delta = TIMER_MIN_LEAD;
+            }
+            if ((uint32_t)delta < soonest) {
+                soonest = delta;
+            }
+        }
+    }
+
+    if (active) {
+        uint16_t target = (uint16_t)(now + soonest);
+        TB0CCR0 = target;
+        TB0CCTL0 = CCIE;
+        if ((int16_t)(target - timer_readCount()) <= 0) {
+            TB0CCTL0 |= CCIFG;                          // passed while computing, fire now
+        }
+    } else {
+        TB0CCTL0 = 0;                                   // no timers, no wake-ups
+    }
+} // end timer_reschedule
+
+void timer_init(void) {
+    TB0CCTL0 = 0;
+    TB0CTL = TBSSEL_1 + MC_2 + TBCLR + TBIE;            // ACLK, continuous mode, clear TBR, overflow interrupt
+} // end timer_init
+
+int8_t timer_start(uint32_t delayMs, uint32_t periodMs, timer_callback_t callback) {
+    int8_t id = TIMER_NONE;
+    uint16_t state = __get_interrupt_state();
+    uint8_t i;
+
+    __disable_interrupt();
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        if (!timer_slots[i].active) {
+            timer_slots[i].deadline = timer_aclkLocked() + TIMER_MS_TO_ACLK(delayMs);
+            timer_slots[i].period = TIMER_MS_TO_ACLK(periodMs);
+            timer_slots[i].callback = callback;
+            timer_slots[i].active = 1;
+            id = i;
+            timer_reschedule();
+            break;
+        }
+    }
+    __set_interrupt_state(state);
+
+    return id;
+} // end timer_start
+
+void timer_stop(int8_t id) {
+    if ((id < 0) || (id >= TIMER_SLOTS)) {
+        return;
+    }
+
+    uint16_t state = __get_interrupt_state();
+    __disable_interrupt();
+    timer_slots[id].active = 0;
+    timer_reschedule();
+    __set_interrupt_state(state);
+} // end timer_stop
+
+uint32_t timer_getAclk(void) {
+    uint32_t aclk;
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    aclk = timer_aclkLocked();
+    __set_interrupt_state(state);
+
+    return aclk;
+} // end timer_getAclk
+
+// Milliseconds since timer_init(); wraps after ~49 days, compare differences.
+uint32_t now_ms(void) {
+    uint32_t high;
+    uint16_t count;
+    uint16_t state = __get_interrupt_state();
+
+    __disable_interrupt();
+    count = timer_readCount();
+    high = timer_overflows;
+    if ((TB0CTL & TBIFG) && (count < 0x8000)) {
+        high++;
+    }
+    __set_interrupt_state(state);
+
+    return (high * 2000) + (((uint32_t)count * 125) >> 12);    // 65536 ACLK = 2000ms
+} // end now_ms
+
+// Sleep until the next wake-up. LPM3 stops the DCO and FLL, so stay in
+// LPM0 while the DCO is still settling after boot.
+void timer_idle(void) {
+    __disable_interrupt();
+    if (!timer_wakePending) {
+        if (clock_getStage() == CLOCK_SETTLING) {
+            power_sleepBegin(POWER_LPM0);
+            __bis_SR_register(LPM0_bits + GIE);
+        } else {
+            power_sleepBegin(POWER_LPM3);
+            __bis_SR_register(LPM3_bits + GIE);
+        }
+        __no_operation();
+        __disable_interrupt();
+        power_sleepEnd();
+    }
+    timer_wakePending = 0;
+    __enable_interrupt();
+} // end timer_idle
+
+static void timer_sleepWake(void) {
+    timer_sleepFired = 1;                               // the slot is free again, id is stale
+} // end timer_sleepWake
+
+// Main loop only. The wake-up one-shot frees its slot when it fires and
+// the slot may be reused right away, so it is only stopped if the loop
+// ended before it fired.
+void sleep_ms(uint16_t ms) {
+    uint32_t end = timer_getAclk() + TIMER_MS_TO_ACLK(ms);
+    int8_t id;
+
+    timer_sleepFired = 0;
+    id = timer_start(ms, 0, timer_sleepWake);
+    while ((int32_t)(timer_getAclk() - end) < 0) {
+        if (id != TIMER_NONE) {
+            timer_idle();                               // otherwise no free slot, poll the counter
+        }
+    }
+
+    uint16_t state = __get_interrupt_state();
+    __disable_interrupt();
+    if (!timer_sleepFired) {
+        timer_stop(id);
+    }
+    __set_interrupt_state(state);
+} // end sleep_ms
+
+//------------------------------------------------------------------------------
+// Timer_B0 CCR0 runs every software timer that is due, then re-arms CCR0
+// for the next deadline and wakes the main loop.
+//------------------------------------------------------------------------------
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMER0_B0_VECTOR
+__interrupt void TIMER0_B0_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMER0_B0_VECTOR))) TIMER0_B0_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    uint32_t now = timer_aclkLocked();
+    uint8_t fired = 0;
+    uint8_t i;
+
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        timer_slot_t *t = &timer_slots[i];
+        if (t->active && ((int32_t)(t->deadline - now) <= 0)) {
+            fired = 1;
+            if (t->period) {
+                t->deadline += t->period;               // periodic, no drift
+            } else {
+                t->active = 0;                          // one-shot, slot free for the callback
+            }
+            if (t->callback) {
+                t->callback();
+            }
+        }
+    }
+
+    timer_reschedule();
+    if (fired) {
+        TIMER_WAKE_ON_EXIT();
+    }
+}
+
+//------------------------------------------------------------------------------
+// Timer_B0 overflow extends the counter every 2s.
+//------------------------------------------------------------------------------
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMER0_B1_VECTOR
+__interrupt void TIMER0_B1_ISR(void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMER0_B1_VECTOR))) TIMER0_B1_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    switch(__even_in_range(TB0IV,14))
+    {
+    case 14:                                            // Vector 14: TBIFG
+        timer_overflows++;
+        break;
+    default: break;
+    }
+}
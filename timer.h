@@ -0,0 +1,45 @@
+/*
+ * timer.h
+ *
+ *  Millisecond timebase on Timer_B0, clocked from ACLK (REFO or XT1, 32768 Hz) so
+ *  it keeps counting in LPM3.
+ *
+ *  The 16-bit counter free-runs and its overflow interrupt extends it to a
+ *  monotonic time, now_ms(). Software timers share CCR0, which is always
+ *  programmed for the earliest deadline, so the CPU is only woken when a
+ *  timer is actually due and there is no periodic tick.
+ *
+ *  Timer callbacks run in interrupt context: keep them short and leave I2C
+ *  traffic to the main loop, e.g. by setting a flag. After any timer fires
+ *  the main loop is woken from timer_idle().
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <msp430.h>
+#include <stdint.h>
+
+#define TIMER_ACLK_HZ       32768UL
+#define TIMER_SLOTS         12                          // software timers
+#define TIMER_NONE          (-1)
+
+#define TIMER_MS_TO_ACLK(ms)    ((((uint32_t)(ms)) << 12) / 125)   // ms * 32768 / 1000, ms < 2^20
+#define TIMER_ACLK_TO_US(aclk)  ((uint32_t)(((uint64_t)(aclk) * 1000000UL) / TIMER_ACLK_HZ))
+
+typedef void (*timer_callback_t)(void);
+
+extern volatile uint8_t timer_wakePending;
+
+// For use at the end of an ISR: make the main loop return from timer_idle().
+#define TIMER_WAKE_ON_EXIT()    do { timer_wakePending = 1; __bic_SR_register_on_exit(LPM3_bits); } while (0)
+
+void timer_init(void);
+int8_t timer_start(uint32_t, uint32_t, timer_callback_t);  // delay ms, period ms (0 = one-shot), callback or 0
+void timer_stop(int8_t);
+uint32_t now_ms(void);
+uint32_t timer_getAclk(void);
+void sleep_ms(uint16_t);
+void timer_idle(void);
+
+#endif /* TIMER_H_ */
@@ -0,0 +1,170 @@
+/*
+ * creds_bench.c
+ *
+ *  Host benchmark for the PIN store (creds.c): lookup latency with 10,
+ *  1,000 and 10,000 users.
+ *
+ *  The store is the real creds.c and sha256.c over a simulated flash.
+ *  For each size the store is formatted and filled, then every user's PIN
+ *  and as many unknown PINs are looked up. Reported per lookup: host time
+ *  and flash words read. The same lookups are then
+ *  repeated with the PIN hash taken out (a work factor of 1 instead of
+ *  CREDS_WORK_FACTOR), which leaves the probing of the two buckets.
+ *
+ *  gcc -O2 -std=c99 -D__TI_COMPILER_VERSION__ -I tools/host -I . \
+ *      tools/host/creds_bench.c creds.c sha256.c -o creds_bench && ./creds_bench
+ *
+ *  Host cycles are not MSP430 cycles. What carries over is the shape:
+ *  the flash words read per lookup do not depend on the number of users,
+ *  and the hash is most of the time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "creds.h"
+#include "flash.h"
+#include "clock.h"
+#include "timer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_NOW()     __rdtsc()
+#define BENCH_UNIT      "cycles"
+#else
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define BENCH_NOW()     bench_ns()
+#define BENCH_UNIT      "ns"
+#endif
+
+/* ====================================================================
+ * Stubs: MCU, flash, clock, timer
+ * ==================================================================== */
+static uint16_t bench_flash[CREDS_SIZE / 2];
+static unsigned long bench_reads;
+static unsigned int bench_tb0r;
+
+void __no_operation(void) {}
+void __enable_interrupt(void) {}
+void __disable_interrupt(void) {}
+unsigned int __get_interrupt_state(void) { return 0; }
+void __set_interrupt_state(unsigned int state) { (void)state; }
+unsigned int host_tb0r(void) { return bench_tb0r++; }
+
+unsigned int __data20_read_short(unsigned long addr) {
+    bench_reads++;
+    if ((addr >= CREDS_BASE) && (addr < CREDS_BASE + CREDS_SIZE)) {
+        return bench_flash[(addr - CREDS_BASE) >> 1];
+    }
+    return 0x5A00 | (addr & 0xFF);                      // die record
+}
+
+void __data20_write_short(unsigned long addr, unsigned int value) {
+    (void)addr;
+    (void)value;
+}
+
+void flash_write16(uint32_t addr, uint16_t value) {
+    bench_flash[(addr - CREDS_BASE) >> 1] &= value;
+}
+
+void flash_eraseSegment(uint32_t addr) {
+    uint32_t offset = (addr - CREDS_BASE) & ~(uint32_t)(FLASH_SEGMENT - 1);
+    memset(&bench_flash[offset >> 1], 0xFF, FLASH_SEGMENT);
+}
+
+void clock_requestBurst(void) {}
+void clock_releaseBurst(void) {}
+uint32_t clock_getMclk(void) { return 25000000UL; }
+uint32_t timer_getAclk(void) { return 0; }
+
+/* ====================================================================
+ * Benchmark
+ * ==================================================================== */
+static void bench_pin(char *pin, uint32_t n) {
+    sprintf(pin, "%06lu", (unsigned long)((n * 7919UL + 104729UL) % 1000000UL));
+}
+
+static void bench_report(const char *what, uint16_t users, uint64_t ticks, unsigned long lookups,
+                         unsigned long reads) {
+    printf("%-5s %6u users %10.0f %s/lookup %6.1f flash words/lookup\n", what, users, (double)ticks / lookups,
+           BENCH_UNIT, (double)reads / lookups);
+}
+
+static int bench_size(uint16_t users, uint16_t workFactor) {
+    static uint32_t pins[10000];                        // index of each PIN added
+    char pin[CREDS_PIN_MAX + 1];
+    uint16_t added = 0;
+    uint16_t refused = 0;
+    uint16_t accepted = 0;
+    uint64_t ticks[2] = { 0, 0 };
+    unsigned long reads[2] = { 0, 0 };
+    unsigned long lookups[2] = { 0, 0 };
+    uint32_t n;
+
+    creds_format();
+    bench_flash[4 / 2] = workFactor;                    // CREDS_HDR_ROUNDS, header word 2
+    creds_init();                                       // adds the default PIN
+    creds_revoke(CREDS_DEFAULT_PIN);
+
+    for (n = 0; added < users; n++) {
+        bench_pin(pin, n);
+        if (creds_add(pin, n & CREDS_USER_MAX, CREDS_ROLE_USER) == CREDS_OK) {
+            pins[added++] = n;
+        } else {
+            refused++;                                  // both buckets full, or a 30-bit hash collision
+        }
+    }
+
+    for (n = 0; n < 2 * (uint32_t)added; n++) {
+        uint8_t hit = (n < added);
+        creds_user_t user;
+
+        bench_pin(pin, hit ? pins[n] : 500000UL + n);   // past every PIN tried
+        unsigned long r = bench_reads;
+        uint64_t t0 = BENCH_NOW();
+        uint8_t result = creds_lookup(pin, &user);
+        ticks[hit] += BENCH_NOW() - t0;
+        reads[hit] += bench_reads - r;
+        lookups[hit]++;
+        if (hit && (result != CREDS_OK)) {
+            printf("FAIL lookup of %s, user %lu\n", pin, (unsigned long)pins[n]);
+            return 1;
+        }
+        if (!hit && (result == CREDS_OK)) {
+            accepted++;                                 // 30-bit key of another user, odds users / 2^30
+        }
+    }
+
+    bench_report("hit", users, ticks[1], lookups[1], reads[1]);
+    bench_report("miss", users, ticks[0], lookups[0], reads[0]);
+    if (refused || accepted) {
+        printf("      %u adds refused, %u unknown PINs accepted\n", refused, accepted);
+    }
+    return 0;
+}
+
+int main(void) {
+    static const uint16_t sizes[] = { 10, 1000, 10000 };
+    unsigned i;
+
+    printf("work factor %u:\n", CREDS_WORK_FACTOR);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (bench_size(sizes[i], CREDS_WORK_FACTOR)) {
+            return 1;
+        }
+    }
+    printf("work factor 1, probing only:\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (bench_size(sizes[i], 1)) {
+            return 1;
+        }
+    }
+    return 0;
+}
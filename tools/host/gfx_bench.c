@@ -0,0 +1,295 @@
+/*
+ * gfx_bench.c
+ *
+ *  Host check and benchmark for ssd1306_gfx.c.
+ *
+ *  Every primitive is run against a pixel-by-pixel reference on random
+ *  arguments (clipping and all three colors included). The framebuffer is
+ *  read back the way the display sees it: gfx_display() streams into a
+ *  shadow GDDRAM through stubbed I2C calls, so a missed dirty range shows
+ *  up as a mismatch too. Then each primitive is timed and reported as
+ *  pixels covered per host cycle (TSC on x86, nanoseconds elsewhere).
+ *
+ *  gcc -O2 -fno-tree-vectorize -std=c99 -fcommon -D__TI_COMPILER_VERSION__ -I tools/host -I . \
+ *      tools/host/gfx_bench.c ssd1306_gfx.c -o gfx_bench && ./gfx_bench
+ *
+ *  -fcommon: ssd1306.h and i2c.h define their buffers in the header.
+ *  -fno-tree-vectorize: the MSP430 has no SIMD, keep the host honest.
+ *  Host cycles are not MSP430 cycles; use the figures to compare the
+ *  primitives with each other and with the reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "ssd1306_gfx.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_NOW()     __rdtsc()
+#define BENCH_UNIT      "cycle"
+#else
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define BENCH_NOW()     bench_ns()
+#define BENCH_UNIT      "ns"
+#endif
+
+#define W   SSD1306_LCDWIDTH
+#define H   SSD1306_LCDHEIGHT
+
+/* ====================================================================
+ * Stubs: the display side of gfx_display()
+ * ==================================================================== */
+static uint8_t gddram[GFX_PAGES][W];
+static uint8_t winCol0, winCol1, winPage, winCol;
+static unsigned long i2cWrites;
+
+void ssd1306_setWindow(uint8_t column0, uint8_t column1, uint8_t page0, uint8_t page1) {
+    (void)page1;
+    winCol0 = column0;
+    winCol1 = column1;
+    winPage = page0;
+    winCol = column0;
+}
+
+void i2c_write(unsigned char *data, unsigned char count) {
+    unsigned char i;
+
+    i2cWrites++;
+    for (i = 1; i < count; i++) {                       // data[0] is the 0x40 control byte
+        gddram[winPage][winCol] = data[i];
+        winCol = (winCol == winCol1) ? winCol0 : winCol + 1;
+    }
+}
+
+/* ====================================================================
+ * Reference, one pixel at a time
+ * ==================================================================== */
+static uint8_t ref[H][W];
+
+static void refPixel(int x, int y, uint8_t color) {
+    if ((x < 0) || (y < 0) || (x >= W) || (y >= H)) {
+        return;
+    }
+    ref[y][x] = (color == GFX_WHITE) ? 1 : (color == GFX_BLACK) ? 0 : !ref[y][x];
+}
+
+static void refFill(int x, int y, int w, int h, uint8_t color) {
+    int i, j;
+    if ((x >= W) || (y >= H)) {
+        return;
+    }
+    for (j = y; (j < y + h) && (j < H); j++) {
+        for (i = x; (i < x + w) && (i < W); i++) {
+            refPixel(i, j, color);
+        }
+    }
+}
+
+static void refRect(int x, int y, int w, int h, uint8_t color) {
+    if ((w == 0) || (h == 0)) {
+        return;
+    }
+    refFill(x, y, w, 1, color);
+    if (h > 1) {
+        refFill(x, y + h - 1, w, 1, color);
+    }
+    if (h > 2) {
+        refFill(x, y + 1, 1, h - 2, color);
+        if (w > 1) {
+            refFill(x + w - 1, y + 1, 1, h - 2, color);
+        }
+    }
+}
+
+static void refLine(int x0, int y0, int x1, int y1, uint8_t color) {
+    int dx = abs(x1 - x0), dy = abs(y1 - y0);
+    int sx = (x1 > x0) ? 1 : -1, sy = (y1 > y0) ? 1 : -1;
+    int x = x0, y = y0, err;
+
+    if (dx >= dy) {
+        for (err = dx >> 1;; x += sx) {
+            refPixel(x, y, color);
+            if (x == x1) {
+                break;
+            }
+            if ((err -= dy) < 0) {
+                y += sy;
+                err += dx;
+            }
+        }
+    } else {
+        for (err = dy >> 1;; y += sy) {
+            refPixel(x, y, color);
+            if (y == y1) {
+                break;
+            }
+            if ((err -= dx) < 0) {
+                x += sx;
+                err += dy;
+            }
+        }
+    }
+}
+
+static void refBitmap(int x, int y, int w, int h, const uint8_t *bitmap, uint8_t color) {
+    int i, j;
+    if ((x >= W) || (y >= H)) {
+        return;
+    }
+    for (j = 0; j < h; j++) {
+        for (i = 0; i < w; i++) {
+            if (bitmap[(j >> 3) * w + i] & (1 << (j & 7))) {
+                refPixel(x + i, y + j, color);
+            }
+        }
+    }
+}
+
+/* ====================================================================
+ * Check
+ * ==================================================================== */
+static int compare(const char *what, int iteration) {
+    int x, y;
+
+    gfx_display();
+    for (y = 0; y < H; y++) {
+        for (x = 0; x < W; x++) {
+            if (((gddram[y >> 3][x] >> (y & 7)) & 1) != ref[y][x]) {
+                printf("FAIL %s, iteration %d: pixel %d,%d\n", what, iteration, x, y);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int check(void) {
+    static uint8_t bitmap[8 * W];
+    int failures = 0;
+    int n;
+
+    i2cWrites = 0;
+    gfx_display();
+    if (i2cWrites) {
+        printf("FAIL nothing drawn yet, but gfx_display() sent %lu writes\n", i2cWrites);
+        failures++;
+    }
+
+    gfx_clear();
+    memset(ref, 0, sizeof(ref));
+    failures += compare("clear", 0);
+
+    for (n = 0; (n < 20000) && !failures; n++) {
+        uint8_t x = rand() % (W + 8), y = rand() % (H + 8);
+        uint8_t w = rand() % (W + 1), h = rand() % (H + 1);
+        uint8_t color = rand() % 3;
+        int i;
+
+        switch (rand() % 6) {
+        case 0:
+            gfx_drawPixel(x, y, color);
+            refPixel(x, y, color);
+            failures += compare("pixel", n);
+            break;
+        case 1:
+            gfx_fillRect(x, y, w, h, color);
+            refFill(x, y, w, h, color);
+            failures += compare("fillRect", n);
+            break;
+        case 2:
+            gfx_drawRect(x, y, w, h, color);
+            refRect(x, y, w, h, color);
+            failures += compare("drawRect", n);
+            break;
+        case 3:
+            x %= W; y %= H; w %= W; h %= H;         // gfx_drawLine takes on-screen endpoints
+            gfx_drawLine(x, y, w, h, color);
+            refLine(x, y, w, h, color);
+            failures += compare("drawLine", n);
+            break;
+        case 4:
+            gfx_drawHLine(x, y, w, color);
+            refFill(x, y, w, 1, color);
+            failures += compare("drawHLine", n);
+            break;
+        default:
+            w %= 48;
+            h %= 40;
+            for (i = 0; i < ((h + 7) >> 3) * w; i++) {
+                bitmap[i] = rand();
+            }
+            gfx_drawBitmap(x, y, w, h, bitmap, color);
+            refBitmap(x, y, w, h, bitmap, color);
+            failures += compare("drawBitmap", n);
+            break;
+        }
+    }
+
+    printf("%s: %d random draws against the pixel reference\n", failures ? "FAIL" : "ok", n);
+    return failures;
+}
+
+/* ====================================================================
+ * Benchmark
+ * ==================================================================== */
+#define REPS    20000
+
+static volatile uint8_t sink;
+
+static void report(const char *what, uint64_t ticks, unsigned long pixels) {
+    printf("%-28s %8.2f px/%s %10.1f %s/call\n", what, (double)pixels * REPS / ticks, BENCH_UNIT,
+           (double)ticks / REPS, BENCH_UNIT);
+}
+
+#define BENCH(what, pixels, call)                       \
+    do {                                                \
+        uint64_t t0 = BENCH_NOW();                      \
+        int r;                                          \
+        for (r = 0; r < REPS; r++) {                    \
+            call;                                       \
+        }                                               \
+        report(what, BENCH_NOW() - t0, pixels);         \
+    } while (0)
+
+static void bench(void) {
+    static uint8_t icon[2 * 16];
+    static uint8_t wide[8 * W];
+    int i;
+
+    for (i = 0; i < (int)sizeof(icon); i++) {
+        icon[i] = rand();
+    }
+    for (i = 0; i < (int)sizeof(wide); i++) {
+        wide[i] = rand();
+    }
+
+    BENCH("drawPixel", 1, gfx_drawPixel(r & 127, r & 63, GFX_INVERT));
+    BENCH("drawHLine 128", W, gfx_drawHLine(0, r & 63, W, GFX_INVERT));
+    BENCH("drawVLine 64", H, gfx_drawVLine(r & 127, 0, H, GFX_INVERT));
+    BENCH("fillRect 128x64", W * H, gfx_fillRect(0, 0, W, H, GFX_INVERT));
+    BENCH("fillRect 30x20 odd x, y", 30 * 20, gfx_fillRect(13, 5, 30, 20, GFX_INVERT));
+    BENCH("drawRect 100x40", 2 * 100 + 2 * 38, gfx_drawRect(7, 9, 100, 40, GFX_INVERT));
+    BENCH("drawLine 127x20", 128, gfx_drawLine(0, 10, 127, 30, GFX_INVERT));
+    BENCH("drawLine 20x63 (steep)", 64, gfx_drawLine(10, 0, 30, 63, GFX_INVERT));
+    BENCH("drawBitmap 16x16 aligned", 16 * 16, gfx_drawBitmap(32, 16, 16, 16, icon, GFX_INVERT));
+    BENCH("drawBitmap 16x16 y+3 x+1", 16 * 16, gfx_drawBitmap(33, 19, 16, 16, icon, GFX_INVERT));
+    BENCH("drawBitmap 128x64", W * H, gfx_drawBitmap(0, 0, W, H, wide, GFX_INVERT));
+    BENCH("reference fillRect 128x64", W * H, refFill(0, 0, W, H, GFX_INVERT));
+    sink = ref[0][0];
+}
+
+int main(void) {
+    srand(1);
+    if (check()) {
+        return 1;
+    }
+    bench();
+    return 0;
+}
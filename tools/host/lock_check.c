@@ -0,0 +1,584 @@
+/*
+ * lock_check.c
+ *
+ *  Host check and benchmark for the lock state machine (lock.c).
+ *
+ *  Every key and timer sequence up to CHECK_DEPTH events long is replayed
+ *  from reset, from each of the ways a lock can come up (unlocked, locked,
+ *  one wrong PIN short of a lockout, in a lockout), and the invariants
+ *  below are checked after every event. The PIN store is the real creds.c
+ *  and sha256.c over a simulated flash, the rest of the firmware is stub
+ *  hooks that only record what they were asked to do. A few longer
+ *  scripted runs check that set-PIN leaves only the new PIN working.
+ *
+ *  Timers fire on demand: 'T' fires the earliest one and then runs
+ *  lock_service(), as the main loop does when woken; 't' only fires it,
+ *  so the next key is handled before the service, as when a timer
+ *  expires while the main loop is busy with keys. 'R' is the actuator
+ *  relocking the door at the end of its dwell, if the door is open.
+ *
+ *  Then the time each event takes is reported in host cycles, apart for
+ *  the events that hash a PIN (TSC on x86, nanoseconds elsewhere). Host
+ *  cycles are not MSP430 cycles; the figures compare the table dispatch
+ *  with the PIN hash it wraps.
+ *
+ *  gcc -O2 -std=c99 -fcommon -D__TI_COMPILER_VERSION__ -DPOWER_ACCOUNTING=0 -I tools/host -I . \
+ *      tools/host/lock_check.c creds.c sha256.c -o lock_check && ./lock_check
+ *
+ *  lock.c is included rather than linked so every replay can start from
+ *  the power-up values of its statics, see check_resetLock().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../../lock.c"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_NOW()     __rdtsc()
+#define BENCH_UNIT      "cycles"
+#else
+static uint64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define BENCH_NOW()     bench_ns()
+#define BENCH_UNIT      "ns"
+#endif
+
+#ifndef CHECK_DEPTH
+#define CHECK_DEPTH     7
+#endif
+
+static const char check_alphabet[] = "01AC*#TtR";
+#define CHECK_SYMBOLS   (sizeof(check_alphabet) - 1)
+
+static unsigned long check_failures;
+static const char *check_sequence;                     // for the failure report
+static int check_step;
+
+static void check_fail(const char *what) {
+    if (check_failures++ < 10) {
+        printf("FAIL %s after \"%.*s\" (state %u)\n", what, check_step, check_sequence, lock_state);
+    }
+} // end check_fail
+
+/* ====================================================================
+ * Stubs: MCU, flash, clock
+ * ==================================================================== */
+static uint16_t check_flash[CREDS_SIZE / 2];
+static uint16_t check_flashAtReset[CREDS_SIZE / 2];
+static uint8_t check_flashDirty;
+static unsigned int check_tb0r;
+static unsigned long check_derives;                     // PIN hashes, counted at clock_requestBurst()
+
+void __no_operation(void) {}
+void __enable_interrupt(void) {}
+void __disable_interrupt(void) {}
+unsigned int __get_interrupt_state(void) { return 0; }
+void __set_interrupt_state(unsigned int state) { (void)state; }
+unsigned int host_tb0r(void) { return check_tb0r++; }
+
+unsigned int __data20_read_short(unsigned long addr) {
+    if ((addr >= CREDS_BASE) && (addr < CREDS_BASE + CREDS_SIZE)) {
+        return check_flash[(addr - CREDS_BASE) >> 1];
+    }
+    if ((addr >= 0x1A0A) && (addr < 0x1A12)) {          // die record
+        return 0x5A00 | (addr & 0xFF);
+    }
+    printf("read outside the simulated flash: 0x%05lx\n", addr);
+    exit(2);
+}
+
+void __data20_write_short(unsigned long addr, unsigned int value) {
+    (void)addr;
+    (void)value;
+    printf("direct flash write\n");
+    exit(2);
+}
+
+void flash_write16(uint32_t addr, uint16_t value) {
+    uint16_t *word = &check_flash[(addr - CREDS_BASE) >> 1];
+
+    if ((addr < CREDS_BASE) || (addr >= CREDS_BASE + CREDS_SIZE) || (addr & 1)) {
+        printf("flash write outside the store: 0x%05lx\n", (unsigned long)addr);
+        exit(2);
+    }
+    *word &= value;                                     // programming only clears bits
+    check_flashDirty = 1;
+}
+
+void flash_eraseSegment(uint32_t addr) {
+    uint32_t offset = (addr - CREDS_BASE) & ~(uint32_t)(FLASH_SEGMENT - 1);
+    memset(&check_flash[offset >> 1], 0xFF, FLASH_SEGMENT);
+    check_flashDirty = 1;
+}
+
+void clock_requestBurst(void) { check_derives++; }
+void clock_releaseBurst(void) {}
+uint32_t clock_getMclk(void) { return 25000000UL; }
+
+/* ====================================================================
+ * Stubs: timers, settings, audit
+ * ==================================================================== */
+typedef struct {
+    uint8_t active;
+    uint32_t deadline;
+    uint32_t period;
+    timer_callback_t callback;
+} check_timer_t;
+
+static check_timer_t check_timers[TIMER_SLOTS];
+static uint32_t check_now;
+
+int8_t timer_start(uint32_t delayMs, uint32_t periodMs, timer_callback_t callback) {
+    int8_t i;
+
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        if (!check_timers[i].active) {
+            check_timers[i].active = 1;
+            check_timers[i].deadline = check_now + delayMs;
+            check_timers[i].period = periodMs;
+            check_timers[i].callback = callback;
+            return i;
+        }
+    }
+    check_fail("out of timers");
+    return TIMER_NONE;
+}
+
+// The firmware ignores a stop of a free slot, but a free slot may be
+// handed out again before the stop, so a stale handle is a bug.
+void timer_stop(int8_t id) {
+    if (id == TIMER_NONE) {
+        return;
+    }
+    if ((id < 0) || (id >= TIMER_SLOTS) || !check_timers[id].active) {
+        check_fail("timer_stop() of a stale handle");
+        return;
+    }
+    check_timers[id].active = 0;
+}
+
+uint32_t now_ms(void) { return check_now; }
+uint32_t timer_getAclk(void) { return (uint32_t)(((uint64_t)check_now * TIMER_ACLK_HZ) / 1000); }
+
+// One-shots free their slot before the callback runs, like timer.c.
+static void check_fireTimer(void) {
+    check_timer_t *next = 0;
+    uint8_t i;
+
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        if (check_timers[i].active && (!next || ((int32_t)(check_timers[i].deadline - next->deadline) < 0))) {
+            next = &check_timers[i];
+        }
+    }
+    if (!next) {
+        return;
+    }
+    check_now = next->deadline;
+    if (next->period) {
+        next->deadline += next->period;
+    } else {
+        next->active = 0;
+    }
+    if (next->callback) {
+        next->callback();
+    }
+}
+
+static uint8_t check_timersActive(void) {
+    uint8_t n = 0;
+    uint8_t i;
+
+    for (i = 0; i < TIMER_SLOTS; i++) {
+        n += check_timers[i].active;
+    }
+    return n;
+}
+
+static struct {
+    uint8_t length;
+    uint8_t data[SETTINGS_MAX_LEN];
+} check_settings[SETTINGS_IDS];
+
+uint8_t settings_read(uint8_t id, void *data, uint8_t size) {
+    uint8_t n = check_settings[id].length;
+
+    if (n > size) {
+        n = size;
+    }
+    memcpy(data, check_settings[id].data, n);
+    return n;
+}
+
+uint8_t settings_write(uint8_t id, const void *data, uint8_t length) {
+    if ((id >= SETTINGS_IDS) || (length > SETTINGS_MAX_LEN)) {
+        check_fail("settings_write() arguments");
+        return SETTINGS_ERR_ARG;
+    }
+    check_settings[id].length = length;
+    memcpy(check_settings[id].data, data, length);
+    return SETTINGS_OK;
+}
+
+void audit_log(uint8_t type, uint8_t arg, uint16_t user);
+
+/* ====================================================================
+ * Stubs: the lock hooks
+ * ==================================================================== */
+static uint8_t check_lockedLed, check_unlockedLed, check_flashing;
+static uint8_t check_mask;                              // glyphs on the display
+static uint8_t check_doorOpen;
+static char check_validPin[LOCK_PIN_MAX + 1];           // the one PIN that should unlock
+
+void lock_showMessage(const char *message) {
+    (void)message;
+    check_mask = 0;                                     // a message replaces the mask line
+}
+
+void lock_showPinMask(uint8_t digits) {
+    if ((digits != check_mask + 1) && (digits + 1 != check_mask)) {
+        check_fail("mask grew or shrank by more than one");
+    }
+    check_mask = digits;
+}
+
+void lock_showSeconds(uint16_t seconds) {
+    int32_t left = (int32_t)(lock_lockoutEnd - check_now);
+
+    if ((lock_state != LOCK_LOCKOUT) || (seconds > LOCK_BACKOFF_MAX_MS / 1000) ||
+        ((left > 0) && ((uint32_t)seconds * 1000 < (uint32_t)left))) {
+        check_fail("countdown");
+    }
+}
+
+void setLockedLEDOn(void) { check_lockedLed = 1; check_flashing = 0; }
+void setLockedLEDOff(void) { check_lockedLed = 0; check_flashing = 0; }
+void setUnlockedLEDOn(void) { check_unlockedLed = 1; }
+void setUnlockedLEDOff(void) { check_unlockedLed = 0; }
+void flashLockedLED(void) { check_flashing = 1; }
+void lock_alarmDisplay(void) {}
+
+void lock_actuateUnlock(void) {
+    if (strcmp(lock_enteredPin, check_validPin) != 0) {
+        check_fail("unlocked with a PIN that is not the current one");
+    }
+    check_doorOpen = 1;
+}
+
+void lock_actuateLock(void) { check_doorOpen = 0; }
+
+void audit_log(uint8_t type, uint8_t arg, uint16_t user) {
+    (void)arg;
+    (void)user;
+    if (type == AUDIT_EV_PIN_ADDED) {
+        strcpy(check_validPin, lock_enteredPin);        // replaces the PIN of the only user
+    }
+}
+
+/* ====================================================================
+ * Check
+ * ==================================================================== */
+#define START_UNLOCKED  0
+#define START_LOCKED    1
+#define START_LAST_TRY  2                               // one wrong PIN from a lockout
+#define START_LOCKOUT   3                               // 10s before now_ms() wraps
+#define STARTS          4
+
+static const char *const check_startNames[STARTS] = { "unlocked", "locked", "last try", "lockout" };
+
+// The power-up values of lock.c's statics; keep in step with lock.c.
+static void check_resetLock(void) {
+    memset(lock_enteredPin, 0, sizeof(lock_enteredPin));
+    lock_index = 0;
+    lock_lastKey = 0;
+    lock_state = LOCK_UNLOCKED;
+    lock_raised = LOCK_EV_NONE;
+    lock_timer = TIMER_NONE;
+    lock_timeoutDue = 0;
+    lock_failures = 0;
+    lock_user.userId = CREDS_DEFAULT_USER;
+    lock_user.role = CREDS_ROLE_ADMIN;
+    lock_storeResult = 0;
+    lock_lockoutEnd = 0;
+    lock_countdownTimer = TIMER_NONE;
+    lock_countdownDue = 0;
+}
+
+static void check_reset(uint8_t start) {
+    uint8_t locked = (start != START_UNLOCKED);
+    uint16_t failures = (start == START_LAST_TRY) ? LOCK_FREE_ATTEMPTS - 1 :
+                        (start == START_LOCKOUT) ? LOCK_FREE_ATTEMPTS : 0;
+
+    if (check_flashDirty) {
+        memcpy(check_flash, check_flashAtReset, sizeof(check_flash));
+        check_flashDirty = 0;
+        creds_init();
+    }
+    memset(check_timers, 0, sizeof(check_timers));
+    memset(check_settings, 0, sizeof(check_settings));
+    settings_write(SETTINGS_ID_LOCK, &locked, 1);
+    settings_write(SETTINGS_ID_FAILURES, &failures, sizeof(failures));
+    check_now = (start == START_LOCKOUT) ? 0UL - 10000 : 0;  // now_ms() wraps during the lockout
+    check_lockedLed = check_unlockedLed = check_flashing = 0;
+    check_mask = 0;
+    check_doorOpen = 0;
+    strcpy(check_validPin, CREDS_DEFAULT_PIN);
+
+    check_resetLock();
+    lock_init();
+}
+
+static void check_invariants(void) {
+    uint8_t state = lock_getState();
+    uint8_t entry = (state == LOCK_SET_PIN) || (state == LOCK_ENTER_PIN);
+    uint8_t locked = 0;
+    uint16_t failures = 0;
+    uint8_t timers;
+    uint8_t i;
+
+    if (state >= LOCK_STATES) {
+        check_fail("no such state");
+        return;
+    }
+    if ((lock_getPinLength() > LOCK_PIN_MAX) || (!entry && lock_getPinLength())) {
+        check_fail("PIN length");
+    }
+    if (strlen(lock_enteredPin) != lock_getPinLength()) {
+        check_fail("PIN buffer not in step with the digit count");
+    }
+    for (i = 0; !entry && (i < sizeof(lock_enteredPin)); i++) {
+        if (lock_enteredPin[i]) {
+            check_fail("PIN not wiped on leaving PIN entry");
+            break;
+        }
+    }
+    if (entry && (check_mask != lock_getPinLength())) {
+        check_fail("mask does not match the digits entered");
+    }
+
+    if (check_unlockedLed != (state == LOCK_UNLOCKED)) {
+        check_fail("unlocked LED");
+    }
+    if (check_lockedLed != ((state != LOCK_UNLOCKED) && (state != LOCK_SET_PIN))) {
+        check_fail("locked LED");
+    }
+    if (check_flashing != ((state == LOCK_WRONG_PIN) || (state == LOCK_LOCKOUT))) {
+        check_fail("locked LED flashing");
+    }
+    if (check_doorOpen && (state != LOCK_UNLOCKED) && (state != LOCK_SET_PIN)) {
+        check_fail("door open while the lock says locked");
+    }
+
+    settings_read(SETTINGS_ID_LOCK, &locked, 1);
+    settings_read(SETTINGS_ID_FAILURES, &failures, sizeof(failures));
+    if (locked != ((state != LOCK_UNLOCKED) && (state != LOCK_SET_PIN))) {
+        check_fail("saved lock state");
+    }
+    if (failures != lock_getFailures()) {
+        check_fail("saved failure count");
+    }
+    // One inactivity timeout in the entry states and unlocked, none when
+    // locked, the backoff and the countdown in a lockout. A timeout that
+    // fired and waits for lock_service() no longer holds a slot.
+    timers = (state == LOCK_LOCKOUT) ? 2 : ((state == LOCK_LOCKED) || (state == LOCK_WRONG_PIN)) ? 0 : 1;
+    if (lock_timeoutDue) {
+        timers--;
+    }
+    if (check_timersActive() != timers) {
+        check_fail("timer leaked or missing");
+    }
+}
+
+static void check_event(char symbol) {
+    if (symbol == 'T') {
+        check_fireTimer();
+        lock_service();
+    } else if (symbol == 't') {
+        check_fireTimer();
+    } else if (symbol == 'R') {
+        if (check_doorOpen) {
+            check_doorOpen = 0;
+            lock_dispatch(LOCK_EV_RELOCKED);
+            if (lock_getState() == LOCK_UNLOCKED) {
+                check_fail("door relocked, the lock still says unlocked");
+            }
+        }
+    } else {
+        lock_key(symbol);
+    }
+}
+
+// Only # with the right PIN unlocks, and it always does.
+static void check_transition(char symbol, uint8_t before, const char *entered) {
+    uint8_t right = (before == LOCK_ENTER_PIN) && (symbol == '#') && (strcmp(entered, check_validPin) == 0);
+
+    if (right != ((before == LOCK_ENTER_PIN) && (lock_getState() == LOCK_UNLOCKED))) {
+        check_fail(right ? "right PIN did not unlock" : "unlocked without the right PIN");
+    }
+}
+
+static unsigned long check_exhaustive(uint8_t start) {
+    char sequence[CHECK_DEPTH + 1];
+    uint8_t digit[CHECK_DEPTH];
+    unsigned long sequences = 0;
+    int i;
+
+    memset(digit, 0, sizeof(digit));
+    sequence[CHECK_DEPTH] = '\0';
+    check_sequence = sequence;
+    for (;;) {
+        for (i = 0; i < CHECK_DEPTH; i++) {
+            sequence[i] = check_alphabet[digit[i]];
+        }
+
+        check_step = 0;
+        check_reset(start);
+        check_invariants();
+        for (check_step = 1; check_step <= CHECK_DEPTH; check_step++) {
+            char entered[LOCK_PIN_MAX + 1];
+            uint8_t before = lock_getState();
+
+            strcpy(entered, lock_enteredPin);
+            check_event(sequence[check_step - 1]);
+            check_invariants();
+            check_transition(sequence[check_step - 1], before, entered);
+            if ((before == LOCK_ENTER_PIN) && (lock_getState() == LOCK_UNLOCKED) && !check_doorOpen) {
+                check_fail("unlocked without opening the door");
+            }
+        }
+        sequences++;
+
+        for (i = CHECK_DEPTH - 1; (i >= 0) && (++digit[i] == CHECK_SYMBOLS); i--) {
+            digit[i] = 0;
+        }
+        if (i < 0) {
+            return sequences;
+        }
+    }
+}
+
+/* ====================================================================
+ * Set-PIN: only the newest PIN of a user unlocks
+ * ==================================================================== */
+static void check_keys(const char *keys, uint8_t expect) {
+    check_sequence = keys;
+    for (check_step = 1; keys[check_step - 1]; check_step++) {
+        check_event(keys[check_step - 1]);
+        check_invariants();
+    }
+    check_step--;
+    if (lock_getState() != expect) {
+        check_fail("unexpected state");
+    }
+}
+
+// A reset that keeps flash and the settings, as a brown-out would.
+static void check_powerCycle(void) {
+    memset(check_timers, 0, sizeof(check_timers));
+    check_lockedLed = check_unlockedLed = check_flashing = 0;
+    check_doorOpen = 0;
+    creds_init();
+    check_resetLock();
+    lock_init();
+}
+
+static void check_setPin(void) {
+    unsigned long failures = check_failures;
+
+    check_reset(START_UNLOCKED);                        // new lock, default admin PIN
+    check_keys("A1234#", LOCK_LOCKED);
+    check_keys("C0000#", LOCK_WRONG_PIN);               // the default is gone
+    check_keys("C1234#", LOCK_UNLOCKED);
+    check_keys("A5678#", LOCK_LOCKED);
+    check_keys("C1234#", LOCK_WRONG_PIN);               // and so is the previous PIN
+    check_keys("C5678#", LOCK_UNLOCKED);
+    check_powerCycle();                                 // resumes unlocked, same user
+    check_keys("A2468#", LOCK_LOCKED);
+    check_keys("C5678#", LOCK_WRONG_PIN);
+    check_keys("C2468#", LOCK_UNLOCKED);
+    if (creds_count() != 1) {
+        check_fail("more than one active PIN for one user");
+    }
+
+    check_reset(START_UNLOCKED);                        // a second user, default still there
+    creds_add("1357", 7, CREDS_ROLE_USER);
+    strcpy(check_validPin, "1357");
+    check_keys("AT", LOCK_LOCKED);                      // set-PIN abandoned
+    check_keys("C1357#", LOCK_UNLOCKED);
+    check_keys("A0000#", LOCK_SET_PIN);                 // the admin's PIN: refused
+    check_keys("9999#", LOCK_LOCKED);
+    check_keys("C1357#", LOCK_WRONG_PIN);
+    check_keys("C0000#", LOCK_WRONG_PIN);               // retired by the first PIN set
+    check_keys("C9999#", LOCK_UNLOCKED);
+    if (creds_count() != 1) {
+        check_fail("old PINs still active");
+    }
+
+    printf("%s: set-PIN replaces the user's PIN and retires the default\n",
+           (check_failures != failures) ? "FAIL" : "ok");
+}
+
+/* ====================================================================
+ * Benchmark
+ * ==================================================================== */
+static void bench(void) {
+    static const char *const scripts[] = {
+        "A0101#C1111#C#C0101#A1111#",                   // set, wrong, right, set again
+        "C01*0**1100#T",                                // edits, wrong PIN
+        "C11*10100#TATC0110#",
+    };
+    uint64_t ticks[2] = { 0, 0 };
+    unsigned long events[2] = { 0, 0 };
+    int rep;
+    unsigned s;
+
+    for (rep = 0; rep < 2000; rep++) {
+        for (s = 0; s < sizeof(scripts) / sizeof(scripts[0]); s++) {
+            const char *p;
+
+            check_reset(START_LOCKED);
+            for (p = scripts[s]; *p; p++) {
+                unsigned long derives = check_derives;
+                uint64_t t0 = BENCH_NOW();
+                check_event(*p);
+                uint64_t t = BENCH_NOW() - t0;
+                uint8_t hashed = (check_derives != derives);
+                ticks[hashed] += t;
+                events[hashed]++;
+            }
+        }
+    }
+
+    printf("%-30s %10.1f %s/event (%lu events)\n", "table dispatch", (double)ticks[0] / events[0], BENCH_UNIT,
+           events[0]);
+    printf("%-30s %10.1f %s/event (%lu events, work factor %u)\n", "PIN check or store", (double)ticks[1] / events[1],
+           BENCH_UNIT, events[1], creds_getWorkFactor());
+}
+
+int main(void) {
+    unsigned long sequences;
+    uint8_t start;
+
+    memset(check_flash, 0xFF, sizeof(check_flash));     // blank part: creds_init() formats it
+    creds_init();
+    memcpy(check_flashAtReset, check_flash, sizeof(check_flash));
+    check_flashDirty = 0;
+
+    for (start = 0; start < STARTS; start++) {
+        sequences = check_exhaustive(start);
+        printf("%s: %lu sequences of %d events from %s\n", check_failures ? "FAIL" : "ok", sequences, CHECK_DEPTH,
+               check_startNames[start]);
+    }
+    check_setPin();
+    if (check_failures) {
+        return 1;
+    }
+    bench();
+    return 0;
+}
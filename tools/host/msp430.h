@@ -0,0 +1,39 @@
+/*
+ * msp430.h
+ *
+ *  Host stand-in for the TI device header, just enough to build the
+ *  hardware-independent modules with a host compiler for the checks and
+ *  benchmarks in this directory. The registers they touch are functions or
+ *  variables the harness defines.
+ *
+ *  Build with -I tools/host -I . and -D__TI_COMPILER_VERSION__, so the
+ *  firmware takes its TI code paths and flash access goes through the
+ *  __data20_* functions below, which the harness implements.
+ */
+
+#ifndef HOST_MSP430_H_
+#define HOST_MSP430_H_
+
+#define __interrupt
+
+#define BIT0    0x0001
+#define BIT1    0x0002
+#define BIT2    0x0004
+#define BIT3    0x0008
+#define BIT4    0x0010
+#define BIT5    0x0020
+#define BIT6    0x0040
+#define BIT7    0x0080
+
+void __no_operation(void);
+void __enable_interrupt(void);
+void __disable_interrupt(void);
+unsigned int __get_interrupt_state(void);
+void __set_interrupt_state(unsigned int);
+unsigned int __data20_read_short(unsigned long);
+void __data20_write_short(unsigned long, unsigned int);
+
+unsigned int host_tb0r(void);                   // must move on, creds_makeSalt() waits for ticks
+#define TB0R    host_tb0r()
+
+#endif /* HOST_MSP430_H_ */
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""
+img_encode.py
+
+Offline encoder for the compressed 1-bpp image format decoded by
+ssd1306_drawImage() (ssd1306_image.c).
+
+Reads plain (P1) or raw (P4) PBM files, converts them to the SSD1306 page
+layout (one byte = 8 vertical pixels, LSB on top, pages top to bottom,
+columns left to right) and compresses that byte stream with a mix of
+run-length and LZ77-style back-references:
+
+    byte 0      width in columns (1..128)
+    byte 1      height in pages (1..8), bit 7 set if the data is stored raw
+    packets     until width * pages bytes have been produced
+        0x00..0x3F  literal: the next (n + 1) bytes are copied
+        0x40..0x7F  unused
+        0x80..0xBF  run:     the next byte is repeated (n & 0x3F) + 2 times
+        0xC0..0xFF  copy:    (n & 0x3F) + 3 bytes are copied from
+                             (next byte + 1) bytes back in the output
+
+Back-references reach at most IMG_WINDOW (128) bytes, one full page row,
+so the decoder only keeps that much history and never a whole frame.
+Images that would not shrink are stored raw behind the same header.
+
+Usage:
+    python3 tools/img_encode.py images/*.pbm
+
+writes images.c and images.h to the current directory and prints the
+compression ratio of every image.
+"""
+
+import os
+import sys
+
+IMG_WINDOW = 128
+MAX_LITERAL = 64
+MAX_RUN = 65
+MIN_COPY = 3
+MAX_COPY = 66
+RAW_FLAG = 0x80
+
+
+def read_pbm(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    tokens = []
+    pos = 0
+
+    def next_token():
+        nonlocal pos
+        while pos < len(data):
+            c = data[pos:pos + 1]
+            if c == b'#':
+                while pos < len(data) and data[pos:pos + 1] not in (b'\n', b'\r'):
+                    pos += 1
+            elif c.isspace():
+                pos += 1
+            else:
+                break
+        start = pos
+        while pos < len(data) and not data[pos:pos + 1].isspace():
+            pos += 1
+        return data[start:pos]
+
+    magic = next_token()
+    width = int(next_token())
+    height = int(next_token())
+
+    if magic == b'P1':
+        bits = []
+        while pos < len(data) and len(bits) < width * height:
+            c = data[pos:pos + 1]
+            if c == b'#':
+                while pos < len(data) and data[pos:pos + 1] != b'\n':
+                    pos += 1
+            elif c in (b'0', b'1'):
+                bits.append(1 if c == b'1' else 0)
+            pos += 1
+    elif magic == b'P4':
+        pos += 1
+        stride = (width + 7) // 8
+        bits = []
+        for y in range(height):
+            row = data[pos + y * stride:pos + (y + 1) * stride]
+            for x in range(width):
+                bits.append((row[x // 8] >> (7 - (x % 8))) & 1)
+    else:
+        raise ValueError('%s: not a PBM file' % path)
+
+    if len(bits) != width * height:
+        raise ValueError('%s: truncated pixel data' % path)
+    if width > 128 or height > 64:
+        raise ValueError('%s: larger than 128x64' % path)
+
+    return width, height, [bits[y * width:(y + 1) * width] for y in range(height)]
+
+
+def to_pages(width, height, rows):
+    pages = (height + 7) // 8
+    out = []
+    for page in range(pages):
+        for x in range(width):
+            b = 0
+            for bit in range(8):
+                y = page * 8 + bit
+                if y < height and rows[y][x]:
+                    b |= 1 << bit
+            out.append(b)
+    return pages, out
+
+
+def encode(raw):
+    out = []
+    literal = []
+
+    def flush_literal():
+        while literal:
+            chunk = literal[:MAX_LITERAL]
+            del literal[:MAX_LITERAL]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+
+    i = 0
+    while i < len(raw):
+        run = 1
+        while i + run < len(raw) and raw[i + run] == raw[i] and run < MAX_RUN:
+            run += 1
+
+        copy = 0
+        offset = 0
+        for back in range(1, min(IMG_WINDOW, i) + 1):
+            n = 0
+            while i + n < len(raw) and raw[i + n] == raw[i - back + n] and n < MAX_COPY:
+                n += 1
+            if n > copy:
+                copy, offset = n, back
+
+        if copy >= MIN_COPY and copy > run:
+            flush_literal()
+            out.append(0xC0 | (copy - MIN_COPY))
+            out.append(offset - 1)
+            i += copy
+        # a run of two only pays off when it does not split a literal
+        elif run >= 3 or (run == 2 and not literal):
+            flush_literal()
+            out.append(0x80 | (run - 2))
+            out.append(raw[i])
+            i += run
+        else:
+            literal.append(raw[i])
+            i += 1
+
+    flush_literal()
+    return out
+
+
+def decode(width, pages, packed):
+    out = []
+    i = 0
+    while len(out) < width * pages:
+        ctrl = packed[i]
+        i += 1
+        if (ctrl & 0xC0) == 0xC0:
+            back = packed[i] + 1
+            for _ in range((ctrl & 0x3F) + MIN_COPY):
+                out.append(out[-back])
+            i += 1
+        elif ctrl & 0x80:
+            out.extend([packed[i]] * ((ctrl & 0x3F) + 2))
+            i += 1
+        else:
+            out.extend(packed[i:i + ctrl + 1])
+            i += ctrl + 1
+    return out
+
+
+def c_array(name, values, comment):
+    lines = ['// %s' % comment, 'const uint8_t %s[%d] = {' % (name, len(values))]
+    for i in range(0, len(values), 12):
+        lines.append('    ' + ', '.join('0x%02X' % v for v in values[i:i + 12]) + ',')
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def main(paths):
+    if not paths:
+        sys.stderr.write(__doc__)
+        return 1
+
+    arrays = []
+    externs = []
+    raw_total = 0
+    packed_total = 0
+
+    for path in paths:
+        name = 'img_' + os.path.splitext(os.path.basename(path))[0]
+        width, height, rows = read_pbm(path)
+        pages, raw = to_pages(width, height, rows)
+        packed = encode(raw)
+        assert decode(width, pages, packed) == raw
+
+        if len(packed) < len(raw):
+            packed = [width, pages] + packed
+        else:
+            packed = [width, pages | RAW_FLAG] + raw
+
+        raw_total += len(raw)
+        packed_total += len(packed)
+        sys.stdout.write('%-20s %3dx%-2d  raw %4d B  packed %4d B  ratio %5.2f:1\n'
+                         % (name, width, height, len(raw), len(packed), len(raw) / len(packed)))
+
+        arrays.append(c_array(name, packed, '%dx%d, %d bytes raw' % (width, pages * 8, len(raw))))
+        externs.append('extern const uint8_t %s[%d];' % (name, len(packed)))
+
+    sys.stdout.write('%-20s         raw %4d B  packed %4d B  ratio %5.2f:1\n'
+                     % ('total', raw_total, packed_total, raw_total / packed_total))
+
+    with open('images.h', 'w') as f:
+        f.write('/*\n * images.h\n *\n *  Generated by tools/img_encode.py, do not edit.\n */\n\n'
+                '#ifndef IMAGES_H_\n#define IMAGES_H_\n\n#include <stdint.h>\n\n')
+        f.write('\n'.join(externs))
+        f.write('\n\n#endif /* IMAGES_H_ */\n')
+
+    with open('images.c', 'w') as f:
+        f.write('/*\n * images.c\n *\n *  Generated by tools/img_encode.py, do not edit.\n'
+                ' *  Format described in tools/img_encode.py and ssd1306_image.h.\n */\n\n'
+                '#include "images.h"\n\n')
+        f.write('\n\n'.join(arrays))
+        f.write('\n')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))